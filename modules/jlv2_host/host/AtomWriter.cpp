@@ -0,0 +1,244 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+namespace jlv2 {
+
+AtomWriter::URIDs AtomWriter::mapURIDs (LV2_URID_Map* map)
+{
+    jassert (map != nullptr);
+    auto m = [map] (const char* uri) -> uint32 { return map->map (map->handle, uri); };
+
+    URIDs u;
+    u.midi_MidiEvent        = m (LV2_MIDI__MidiEvent);
+    u.time_Position         = m (LV2_TIME__Position);
+    u.time_frame            = m (LV2_TIME__frame);
+    u.time_speed            = m (LV2_TIME__speed);
+    u.time_bar              = m (LV2_TIME__bar);
+    u.time_barBeat          = m (LV2_TIME__barBeat);
+    u.time_beatUnit         = m (LV2_TIME__beatUnit);
+    u.time_beatsPerBar      = m (LV2_TIME__beatsPerBar);
+    u.time_beatsPerMinute   = m (LV2_TIME__beatsPerMinute);
+    u.patch_Set             = m (LV2_PATCH__Set);
+    u.patch_Get             = m (LV2_PATCH__Get);
+    u.patch_property        = m (LV2_PATCH__property);
+    u.patch_value           = m (LV2_PATCH__value);
+    return u;
+}
+
+AtomWriter::AtomWriter (LV2_URID_Map* map)
+    : urids (mapURIDs (map))
+{
+    lv2_atom_forge_init (&forge, map);
+    lv2_atom_forge_set_buffer (&forge, nullptr, 0);
+}
+
+//=============================================================================
+bool AtomWriter::begin (PortBuffer& buffer)
+{
+    jassert (sequence == nullptr); // missing end()?
+    sequence = nullptr;
+    depth = 0;
+
+    if (! buffer.isSequence())
+        return false;
+
+    auto* const seq = static_cast<LV2_Atom_Sequence*> (buffer.getPortData());
+    const uint32 used = (uint32) lv2_atom_total_size (&seq->atom);
+
+    // an output not cleared since the plugin ran claims its whole capacity
+    if (seq->atom.type != forge.Sequence || used >= buffer.getCapacity())
+        return false;
+
+    // append after whatever the sequence already holds
+    lv2_atom_forge_set_buffer (&forge, reinterpret_cast<uint8_t*> (seq), buffer.getCapacity());
+    forge.offset = used;
+    lv2_atom_forge_push (&forge, &sequenceFrame, (LV2_Atom_Forge_Ref) seq);
+    sequence = seq;
+    return true;
+}
+
+void AtomWriter::end()
+{
+    jassert (depth == 0); // a frame is still open
+    if (sequence != nullptr)
+        lv2_atom_forge_pop (&forge, &sequenceFrame);
+    lv2_atom_forge_set_buffer (&forge, nullptr, 0);
+    sequence = nullptr;
+    depth = 0;
+}
+
+//=============================================================================
+bool AtomWriter::startEvent (int64 frame)
+{
+    // nothing to write into: begin() failed or wasn't called
+    if (sequence == nullptr)
+    {
+        failed = true;
+        return false;
+    }
+
+    if (depth == 0)
+    {
+        failed              = false;
+        eventOffset         = forge.offset;
+        eventSequenceSize   = sequence->atom.size;
+    }
+
+    return check (lv2_atom_forge_frame_time (&forge, frame));
+}
+
+bool AtomWriter::finishEvent()
+{
+    if (! failed)
+        return true;
+
+    // drop everything written for this event
+    if (sequence != nullptr)
+    {
+        forge.offset        = eventOffset;
+        forge.stack         = &sequenceFrame;
+        sequence->atom.size = eventSequenceSize;
+    }
+
+    failed = false;
+    depth  = 0;
+    return false;
+}
+
+//=============================================================================
+bool AtomWriter::writeMidi (int64 frame, const uint8* data, uint32 size)
+{
+    if (startEvent (frame))
+        if (check (lv2_atom_forge_atom (&forge, size, urids.midi_MidiEvent)))
+            check (lv2_atom_forge_write (&forge, data, size));
+    return finishEvent();
+}
+
+bool AtomWriter::writePosition (int64 frame, const AudioPlayHead::CurrentPositionInfo& pos)
+{
+    const int numerator   = jmax (1, pos.timeSigNumerator);
+    const int denominator = jmax (1, pos.timeSigDenominator);
+    const double beatsPerQuarter = denominator / 4.0;
+    const double bar     = pos.ppqPositionOfLastBarStart * beatsPerQuarter / numerator;
+    const double barBeat = (pos.ppqPosition - pos.ppqPositionOfLastBarStart) * beatsPerQuarter;
+
+    LV2_Atom_Forge_Frame object;
+    if (beginObject (object, frame, urids.time_Position))
+    {
+        key (urids.time_frame);             writeLong ((int64) pos.timeInSamples);
+        key (urids.time_speed);             writeFloat (pos.isPlaying ? 1.f : 0.f);
+        key (urids.time_bar);               writeLong ((int64) bar);
+        key (urids.time_barBeat);           writeFloat ((float) barBeat);
+        key (urids.time_beatUnit);          writeInt ((int32) denominator);
+        key (urids.time_beatsPerBar);       writeFloat ((float) numerator);
+        key (urids.time_beatsPerMinute);    writeFloat ((float) pos.bpm);
+    }
+
+    return pop (object);
+}
+
+bool AtomWriter::writePatchSet (int64 frame, uint32 property, float value)
+{
+    LV2_Atom_Forge_Frame object;
+    if (beginObject (object, frame, urids.patch_Set))
+    {
+        key (urids.patch_property);     writeURID (property);
+        key (urids.patch_value);        writeFloat (value);
+    }
+
+    return pop (object);
+}
+
+bool AtomWriter::writeVector (int64 frame, uint32 childType, uint32 childSize,
+                              uint32 numElements, const void* elements)
+{
+    if (startEvent (frame))
+        writeVector (childType, childSize, numElements, elements);
+    return finishEvent();
+}
+
+//=============================================================================
+bool AtomWriter::beginObject (LV2_Atom_Forge_Frame& frame, int64 time, uint32 objectType)
+{
+    jassert (depth == 0); // use the overload without a time inside a frame
+    if (! startEvent (time))
+    {
+        ++depth;   // pop() rolls back
+        return false;
+    }
+
+    return beginObject (frame, objectType);
+}
+
+bool AtomWriter::beginTuple (LV2_Atom_Forge_Frame& frame, int64 time)
+{
+    jassert (depth == 0);
+    if (! startEvent (time))
+    {
+        ++depth;
+        return false;
+    }
+
+    return beginTuple (frame);
+}
+
+bool AtomWriter::beginObject (LV2_Atom_Forge_Frame& frame, uint32 objectType)
+{
+    ++depth;
+    return check (lv2_atom_forge_object (&forge, &frame, 0, objectType));
+}
+
+bool AtomWriter::beginTuple (LV2_Atom_Forge_Frame& frame)
+{
+    ++depth;
+    return check (lv2_atom_forge_tuple (&forge, &frame));
+}
+
+bool AtomWriter::key (uint32 property)      { return ! failed && check (lv2_atom_forge_key (&forge, property)); }
+bool AtomWriter::writeInt (int32 value)     { return ! failed && check (lv2_atom_forge_int (&forge, value)); }
+bool AtomWriter::writeLong (int64 value)    { return ! failed && check (lv2_atom_forge_long (&forge, value)); }
+bool AtomWriter::writeFloat (float value)   { return ! failed && check (lv2_atom_forge_float (&forge, value)); }
+bool AtomWriter::writeDouble (double value) { return ! failed && check (lv2_atom_forge_double (&forge, value)); }
+bool AtomWriter::writeBool (bool value)     { return ! failed && check (lv2_atom_forge_bool (&forge, value)); }
+bool AtomWriter::writeURID (uint32 value)   { return ! failed && check (lv2_atom_forge_urid (&forge, value)); }
+
+bool AtomWriter::writeString (const char* text, uint32 length)
+{
+    return ! failed && check (lv2_atom_forge_string (&forge, text, length));
+}
+
+bool AtomWriter::writeVector (uint32 childType, uint32 childSize, uint32 numElements, const void* elements)
+{
+    return ! failed && check (lv2_atom_forge_vector (&forge, childSize, childType, numElements, elements));
+}
+
+bool AtomWriter::pop (LV2_Atom_Forge_Frame& frame)
+{
+    jassert (depth > 0);
+
+    // a frame which failed to open was never pushed
+    if (forge.stack == &frame)
+        lv2_atom_forge_pop (&forge, &frame);
+
+    if (--depth > 0)
+        return ! failed;
+
+    return finishEvent();
+}
+
+}
@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Appends typed events to an atom sequence PortBuffer with an LV2 atom forge.
+
+    URIDs are mapped once when the writer is made, and the buffer is checked
+    once in begin(). Nothing allocates. Each event either fits whole or is
+    rolled back, so a full buffer never leaves half an object behind.
+
+    @code
+    writer.begin (buffer);
+    writer.writeMidi (0, data, size);
+
+    LV2_Atom_Forge_Frame frame;
+    writer.beginObject (frame, 64, writer.urids.patch_Set);
+    writer.key (writer.urids.patch_property);  writer.writeURID (gain);
+    writer.key (writer.urids.patch_value);     writer.writeFloat (0.5f);
+    writer.pop (frame);
+
+    writer.end();
+    @endcode
+ */
+class AtomWriter final
+{
+public:
+    /** Create a writer which maps its URIDs with map */
+    explicit AtomWriter (LV2_URID_Map* map);
+    ~AtomWriter() = default;
+
+    /** URIDs of the types and properties the writer knows about */
+    struct URIDs
+    {
+        uint32 midi_MidiEvent;
+        uint32 time_Position, time_frame, time_speed, time_bar, time_barBeat,
+               time_beatUnit, time_beatsPerBar, time_beatsPerMinute;
+        uint32 patch_Set, patch_Get, patch_property, patch_value;
+    };
+
+    const URIDs urids;
+
+    //=========================================================================
+    /** Start appending to a sequence (realtime)
+        @returns false if the buffer isn't an atom sequence or is already full */
+    bool begin (PortBuffer& buffer);
+
+    /** Stop appending (realtime) */
+    void end();
+
+    //=========================================================================
+    /** Append a MIDI message, sysex included */
+    bool writeMidi (int64 frame, const uint8* data, uint32 size);
+
+    /** Append a time:Position object describing the transport */
+    bool writePosition (int64 frame, const AudioPlayHead::CurrentPositionInfo& position);
+
+    /** Append a patch:Set object setting a float property */
+    bool writePatchSet (int64 frame, uint32 property, float value);
+
+    /** Append an atom:Vector of numElements children */
+    bool writeVector (int64 frame, uint32 childType, uint32 childSize,
+                      uint32 numElements, const void* elements);
+
+    //=========================================================================
+    /** Start an object event. Add properties with key() and the write
+        methods, then pop() the frame */
+    bool beginObject (LV2_Atom_Forge_Frame& frame, int64 time, uint32 objectType);
+
+    /** Start a tuple event. Add members with the write methods, then pop() the frame */
+    bool beginTuple (LV2_Atom_Forge_Frame& frame, int64 time);
+
+    /** Start a nested object or tuple inside an open frame */
+    bool beginObject (LV2_Atom_Forge_Frame& frame, uint32 objectType);
+    bool beginTuple (LV2_Atom_Forge_Frame& frame);
+
+    /** Write a property key inside an open object */
+    bool key (uint32 property);
+
+    bool writeInt    (int32 value);
+    bool writeLong   (int64 value);
+    bool writeFloat  (float value);
+    bool writeDouble (double value);
+    bool writeBool   (bool value);
+    bool writeURID   (uint32 value);
+    bool writeString (const char* text, uint32 length);
+    bool writeVector (uint32 childType, uint32 childSize, uint32 numElements, const void* elements);
+
+    /** Close a frame. Closing the outermost one finishes the event
+        @returns false if anything in the event didn't fit, in which case
+                 the whole event was dropped */
+    bool pop (LV2_Atom_Forge_Frame& frame);
+
+    /** The forge itself, for anything else. Writes made directly aren't
+        rolled back if they don't fit */
+    inline LV2_Atom_Forge& getForge() { return forge; }
+
+private:
+    LV2_Atom_Forge forge;
+    LV2_Atom_Forge_Frame sequenceFrame;
+    LV2_Atom_Sequence* sequence = nullptr;
+
+    int depth = 0;                  ///< open frames within the current event
+    bool failed = false;            ///< something in the current event didn't fit
+    uint32 eventOffset = 0;         ///< forge offset where the current event began
+    uint32 eventSequenceSize = 0;   ///< sequence size before the current event
+
+    static URIDs mapURIDs (LV2_URID_Map* map);
+    bool startEvent (int64 frame);
+    bool finishEvent();
+    inline bool check (LV2_Atom_Forge_Ref ref)  { failed |= ref == 0; return ref != 0; }
+
+    JUCE_DECLARE_NON_COPYABLE (AtomWriter)
+};
+
+}
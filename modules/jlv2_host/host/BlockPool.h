@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** A fixed number of equally sized memory blocks, preallocated.
+
+    Any thread may take or give back a block without locking or allocating,
+    so a realtime thread can fill a block and pass just its index to
+    another thread, which frees it when done.
+ */
+class BlockPool final
+{
+public:
+    BlockPool() = default;
+    ~BlockPool() = default;
+
+    /** Allocate numBlocks blocks of blockSize bytes each
+        @note This is NOT realtime safe, and nothing may use the pool meanwhile.
+              Every block must have been given back */
+    void resize (uint32 newBlockSize, int newNumBlocks)
+    {
+        jassert (numFree.load() == numBlocks);
+
+        blockSize = (newBlockSize + 63) & ~63u;
+        numBlocks = jmax (0, newNumBlocks);
+        storage.allocate ((size_t) blockSize * (size_t) numBlocks, false);
+        freeList.resize (numBlocks);
+        for (int i = 0; i < numBlocks; ++i)
+            freeList.push ((uint32) i);
+        numFree.store (numBlocks);
+    }
+
+    /** Returns the most bytes a block holds */
+    inline uint32 getBlockSize() const { return blockSize; }
+
+    /** Take a free block with room for size bytes (any thread)
+        @returns The block's index, or -1 if it's too big or none are free */
+    inline int allocate (uint32 size)
+    {
+        uint32 block = 0;
+        if (size > blockSize || ! freeList.pop (block))
+        {
+            numFailed.fetch_add (1, std::memory_order_relaxed);
+            return -1;
+        }
+
+        numFree.fetch_sub (1, std::memory_order_relaxed);
+        return (int) block;
+    }
+
+    /** Give a block back (any thread) */
+    inline void free (int block)
+    {
+        jassert (isPositiveAndBelow (block, numBlocks));
+        freeList.push ((uint32) block);
+        numFree.fetch_add (1, std::memory_order_release);
+    }
+
+    /** Returns a block's memory */
+    inline uint8* getData (int block) const
+    {
+        jassert (isPositiveAndBelow (block, numBlocks));
+        return storage.getData() + (size_t) block * blockSize;
+    }
+
+    /** Returns how many times allocate() found nothing suitable */
+    inline uint32 getNumFailed() const { return numFailed.load (std::memory_order_relaxed); }
+
+private:
+    HeapBlock<uint8> storage;
+    uint32 blockSize = 0;
+    int numBlocks = 0;
+    MPMCQueue<uint32> freeList;
+    std::atomic<int> numFree { 0 };
+    std::atomic<uint32> numFailed { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (BlockPool)
+};
+
+}
@@ -0,0 +1,142 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define JLV2_BUFFER_PLANNER_ALIGNMENT   64
+
+namespace jlv2 {
+
+static size_t bufferPlannerAlign (size_t size)
+{
+    return (size + JLV2_BUFFER_PLANNER_ALIGNMENT - 1) & ~(size_t) (JLV2_BUFFER_PLANNER_ALIGNMENT - 1);
+}
+
+void BufferPlanner::clear()
+{
+    values.clearQuick();
+    buffers.clearQuick();
+    arena.free();
+    base = nullptr;
+    arenaSize = 0;
+}
+
+int BufferPlanner::add (uint32 size, int first, int last)
+{
+    jassert (first <= last);
+    Value value;
+    value.size  = jmax ((uint32) sizeof (float), size);
+    value.first = first;
+    value.last  = jmax (first, last);
+    values.add (value);
+    return values.size() - 1;
+}
+
+void BufferPlanner::use (int value, int step)
+{
+    jassert (isPositiveAndBelow (value, values.size()));
+    auto& v = values.getReference (value);
+    v.first = jmin (v.first, step);
+    v.last  = jmax (v.last, step);
+}
+
+size_t BufferPlanner::getUnsharedSize() const
+{
+    size_t size = 0;
+    for (const auto& value : values)
+        size += bufferPlannerAlign (value.size);
+    return size;
+}
+
+void BufferPlanner::plan()
+{
+    buffers.clearQuick();
+
+    // visit values in the order they start
+    Array<int> order;
+    order.ensureStorageAllocated (values.size());
+    for (int i = 0; i < values.size(); ++i)
+        order.add (i);
+
+    std::stable_sort (order.begin(), order.end(), [this] (int a, int b) {
+        return values.getReference(a).first < values.getReference(b).first;
+    });
+
+    for (const auto index : order)
+    {
+        auto& value = values.getReference (index);
+
+        // best fit among the free buffers, else the biggest free one grown
+        int fit = -1, biggest = -1;
+        for (int b = 0; b < buffers.size(); ++b)
+        {
+            const auto& buffer = buffers.getReference (b);
+            if (values.getReference(buffer.tenant).last >= value.first)
+                continue;
+            if (canShare && ! canShare (buffer.tenant, index))
+                continue;
+
+            if (buffer.size >= value.size)
+            {
+                if (fit < 0 || buffer.size < buffers.getReference(fit).size)
+                    fit = b;
+            }
+            else if (biggest < 0 || buffer.size > buffers.getReference(biggest).size)
+            {
+                biggest = b;
+            }
+        }
+
+        if (fit < 0)
+            fit = biggest;
+
+        if (fit < 0)
+        {
+            Buffer buffer;
+            buffer.size = value.size;
+            buffer.tenant = index;
+            buffers.add (buffer);
+            fit = buffers.size() - 1;
+        }
+
+        auto& buffer = buffers.getReference (fit);
+        buffer.size   = jmax (buffer.size, value.size);
+        buffer.tenant = index;
+        value.buffer  = fit;
+    }
+
+    arenaSize = 0;
+    for (auto& buffer : buffers)
+    {
+        buffer.offset = arenaSize;
+        arenaSize += bufferPlannerAlign (buffer.size);
+    }
+
+    arena.allocate (arenaSize + JLV2_BUFFER_PLANNER_ALIGNMENT, true);
+    base = reinterpret_cast<uint8*> (
+        (reinterpret_cast<pointer_sized_int> (arena.getData()) + JLV2_BUFFER_PLANNER_ALIGNMENT - 1)
+            & ~(pointer_sized_int) (JLV2_BUFFER_PLANNER_ALIGNMENT - 1));
+}
+
+void* BufferPlanner::getBuffer (int value) const
+{
+    jassert (isPositiveAndBelow (value, values.size()));
+    const int buffer = values.getReference(value).buffer;
+    jassert (buffer >= 0); // not planned yet
+    return base + buffers.getReference(buffer).offset;
+}
+
+}
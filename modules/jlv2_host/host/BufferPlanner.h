@@ -0,0 +1,100 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Shares memory between port buffers whose lifetimes don't overlap.
+
+    Each value (an output port and everything reading it) is live from the
+    step where it's written to the last step where it's read. Values are
+    packed into as few physical buffers as possible with a linear scan over
+    those intervals, the way a compiler allocates registers. The buffers are
+    carved out of one arena, ready to be handed to PortBuffer::referTo.
+
+    Steps are whatever order the caller runs things in. Give a value's first
+    step as one past the step its producer reads its inputs at to let it take
+    over an input's buffer (processing in place), or the same step to keep
+    them apart.
+ */
+class BufferPlanner final
+{
+public:
+    BufferPlanner() = default;
+    ~BufferPlanner() = default;
+
+    /** Forget all values and release the arena */
+    void clear();
+
+    /** Add a value of size bytes, live from step first to step last inclusive
+        @returns The value's index */
+    int add (uint32 size, int first, int last);
+
+    /** Extend a value's life to include step */
+    void use (int value, int step);
+
+    /** Returns the number of values added */
+    inline int getNumValues() const { return values.size(); }
+
+    /** Optional extra test for a buffer whose last tenant is done by the
+        time next starts. Return false to keep them apart anyway, for
+        example when they might run on different threads */
+    std::function<bool (int previous, int next)> canShare;
+
+    /** Assign every value a buffer and allocate the arena
+        @note This is NOT realtime safe */
+    void plan();
+
+    /** Returns the memory planned for a value */
+    void* getBuffer (int value) const;
+
+    /** Returns the number of physical buffers after plan() */
+    inline int getNumBuffers() const { return buffers.size(); }
+
+    /** Returns the bytes the arena holds */
+    inline size_t getArenaSize() const { return arenaSize; }
+
+    /** Returns the bytes needed if nothing were shared */
+    size_t getUnsharedSize() const;
+
+private:
+    struct Value
+    {
+        uint32 size;
+        int first, last;
+        int buffer = -1;
+    };
+
+    struct Buffer
+    {
+        uint32 size;
+        int tenant;         ///< value which used it last
+        size_t offset = 0;
+    };
+
+    Array<Value> values;
+    Array<Buffer> buffers;
+    HeapBlock<uint8> arena;
+    uint8* base = nullptr;
+    size_t arenaSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (BufferPlanner)
+};
+
+}
@@ -0,0 +1,126 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** A table of float values with a dirty bit per slot.
+
+    Any thread may set values without locking. A single reader collects
+    the slots which changed since it last looked, getting only the latest
+    value of each. The dirty bits are packed into 64 bit words on their
+    own cache lines, so a reader can skip 512 unchanged slots per line.
+ */
+class ControlSlots final
+{
+public:
+    ControlSlots() = default;
+    ~ControlSlots() { resize (0); }
+
+    /** Resize the table. All values are zeroed and marked clean
+        @note This is NOT realtime safe */
+    void resize (int newNumSlots)
+    {
+        numSlots = jmax (0, newNumSlots);
+        numWords = (numSlots + 63) / 64;
+        const int numLines = (numWords + wordsPerLine - 1) / wordsPerLine;
+
+        storage.free();
+        dirty  = nullptr;
+        values = nullptr;
+        if (numSlots <= 0)
+            return;
+
+        const size_t dirtyBytes = (size_t) numLines * cacheLineSize;
+        storage.calloc (dirtyBytes + (sizeof (std::atomic<float>) * (size_t) numSlots) + cacheLineSize);
+        auto* const aligned = reinterpret_cast<uint8*> (
+            (reinterpret_cast<pointer_sized_uint> (storage.getData()) + cacheLineSize - 1)
+                & ~static_cast<pointer_sized_uint> (cacheLineSize - 1));
+
+        dirty  = reinterpret_cast<std::atomic<uint64>*> (aligned);
+        values = reinterpret_cast<std::atomic<float>*> (aligned + dirtyBytes);
+
+        for (int i = 0; i < numWords; ++i)
+            new (dirty + i) std::atomic<uint64> (0);
+        for (int i = 0; i < numSlots; ++i)
+            new (values + i) std::atomic<float> (0.f);
+    }
+
+    /** Returns the number of slots */
+    inline int size() const { return numSlots; }
+
+    /** Set a value and mark it dirty (lock-free, any thread) */
+    inline void set (int slot, float value)
+    {
+        jassert (isPositiveAndBelow (slot, numSlots));
+        values[slot].store (value, std::memory_order_relaxed);
+        dirty[slot >> 6].fetch_or (static_cast<uint64> (1) << (slot & 63), std::memory_order_release);
+    }
+
+    /** Returns the latest value of a slot (lock-free, any thread) */
+    inline float get (int slot) const
+    {
+        jassert (isPositiveAndBelow (slot, numSlots));
+        return values[slot].load (std::memory_order_relaxed);
+    }
+
+    /** Calls fn (slot, value) for every slot set since the last call, and
+        marks them clean. Only one thread at a time may collect (realtime) */
+    template<typename Callback>
+    inline void collect (Callback&& fn)
+    {
+        for (int w = 0; w < numWords; ++w)
+        {
+            if (dirty[w].load (std::memory_order_relaxed) == 0)
+                continue;
+
+            auto bits = dirty[w].exchange (0, std::memory_order_acquire);
+            while (bits != 0)
+            {
+                const int slot = (w << 6) + countTrailingZeros (bits);
+                bits &= bits - 1;
+                fn (slot, values[slot].load (std::memory_order_relaxed));
+            }
+        }
+    }
+
+private:
+    enum { cacheLineSize = 64, wordsPerLine = cacheLineSize / sizeof (uint64) };
+
+    HeapBlock<uint8> storage;
+    std::atomic<uint64>* dirty = nullptr;
+    std::atomic<float>* values = nullptr;
+    int numSlots = 0;
+    int numWords = 0;
+
+    static inline int countTrailingZeros (uint64 bits) noexcept
+    {
+       #if JUCE_MSVC
+        unsigned long index = 0;
+        _BitScanForward64 (&index, bits);
+        return (int) index;
+       #else
+        return __builtin_ctzll (bits);
+       #endif
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ControlSlots)
+};
+
+}
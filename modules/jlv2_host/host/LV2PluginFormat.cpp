@@ -81,10 +81,18 @@ public:
 
     /** Will write to Port with correct min max ratio conversion */
     void setValue (float newValue) override
+    {
+        setValueAt (newValue, 0);
+    }
+
+    /** Same as setValue, but the port changes at a sample offset into the
+        next processed block
+        @returns false if the module's event queue was full */
+    bool setValueAt (float newValue, int sampleOffset)
     {
         value.set (newValue);
         const auto expanded = convertFrom0to1 (newValue);
-        module.write (portIdx, sizeof(float), 0, &expanded);
+        return module.write (portIdx, sizeof(float), 0, &expanded, sampleOffset);
     }
 
     float getDefaultValue() const override      { return convertTo0to1 (defaultValue); }
@@ -241,20 +249,29 @@ public:
 
         jassert (map != nullptr);
         jassert (module != nullptr);
+        atomWriter.reset (new AtomWriter (map));
+        lastPosition.resetToDefault();
 
         atomSequence = module->map (LV2_ATOM__Sequence);
         midiEvent    = module->map (LV2_MIDI__MidiEvent);
         numPorts     = module->getNumPorts();
         midiPort     = module->getMidiPort();
+        positionPort = module->getTimePositionPort();
         notifyPort   = module->getNotifyPort();
+        latencyPort  = module->getLatencyPort();
 
         for (uint32 p = 0; p < numPorts; ++p)
+        {
             if (module->isPortInput (p) && PortType::Control == module->getPortType (p))
                 addParameter (LV2AudioParameter::create (p, *module));
+            else if (! module->isPortInput (p) && PortType::Atom == module->getPortType (p))
+                atomOutputs.add (p);
+        }
  
+        // CV ports follow the audio ports as extra channels
         const ChannelConfig& channels (module->getChannelConfig());
-        setPlayConfigDetails (channels.getNumAudioInputs(),
-                              channels.getNumAudioOutputs(), 44100.0, 1024);
+        setPlayConfigDetails (channels.getNumAudioInputs() + channels.getNumCVInputs(),
+                              channels.getNumAudioOutputs() + channels.getNumCVOutputs(), 44100.0, 1024);
 
         if (! module->hasEditor())
         {
@@ -274,12 +291,23 @@ public:
     {
         if (protocol != 0)
             return;
+        if (port == latencyPort)
+            return setLatencySamples (roundToInt (*(float*) data));
         for (int i = 0; i < getParameters().size(); ++i)
             if (auto* const param = dynamic_cast<LV2AudioParameter*> (getParameters()[i]))
                 if (port == param->getPort() && protocol == 0)
                     { param->update (*(float*) data, true); break; }
     };
 
+    /** Set a parameter so it changes at a sample offset into the next call
+        to processBlock. Use this to pass through sample accurate automation */
+    bool setParameterValueAt (int parameterIndex, float newValue, int sampleOffset)
+    {
+        if (auto* const param = dynamic_cast<LV2AudioParameter*> (getParameters()[parameterIndex]))
+            return param->setValueAt (newValue, sampleOffset);
+        return false;
+    }
+
     //=========================================================================
     void fillInPluginDescription (PluginDescription& desc) const
     {
@@ -299,8 +327,10 @@ public:
         desc.manufacturerName = module->getAuthorName();
         desc.version = "";
 
-        desc.numInputChannels  = module->getNumPorts (PortType::Audio, true);
-        desc.numOutputChannels = module->getNumPorts (PortType::Audio, false);
+        desc.numInputChannels  = module->getNumPorts (PortType::Audio, true)
+                               + module->getNumPorts (PortType::CV, true);
+        desc.numOutputChannels = module->getNumPorts (PortType::Audio, false)
+                               + module->getNumPorts (PortType::CV, false);
         desc.isInstrument = module->getMidiPort() != LV2UI_INVALID_PORT_INDEX;
     }
 
@@ -328,21 +358,29 @@ public:
     const String getName() const     { return module->getName(); }
     bool silenceInProducesSilenceOut() const { return false; }
     bool acceptsMidi()  const        { return wantsMidiMessages; }
-    bool producesMidi() const        { return notifyPort != LV2UI_INVALID_PORT_INDEX; }
+    bool producesMidi() const        { return ! atomOutputs.isEmpty(); }
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int blockSize)
     {
         const ChannelConfig& channels (module->getChannelConfig());
-        setPlayConfigDetails (channels.getNumAudioInputs(),
-                              channels.getNumAudioOutputs(),
+        setPlayConfigDetails (channels.getNumAudioInputs() + channels.getNumCVInputs(),
+                              channels.getNumAudioOutputs() + channels.getNumCVOutputs(),
                               sampleRate, blockSize);
         initialise();
 
         if (initialised)
         {
-            module->setSampleRate (sampleRate);
+            module->setSampleAccurateControl (true);
+            module->prepare (sampleRate, (uint32) blockSize);
             tempBuffer.setSize (jmax (1, getTotalNumOutputChannels()), blockSize);
+
+            // an atom event never takes less room than the same MIDI event
+            midiOutputSize = 0;
+            for (const auto port : atomOutputs)
+                midiOutputSize += module->getPortBuffer (port)->getCapacity();
+            midiOutput.ensureSize ((size_t) midiOutputSize);
+            nextTimeInSamples = -1;
             module->activate();
         }
     }
@@ -367,52 +405,83 @@ public:
             return;
         }
 
-        if (AudioPlayHead* const playHead = getPlayHead ())
+        const ChannelConfig& chans (module->getChannelConfig());
+
+        AudioPlayHead::CurrentPositionInfo position;
+        bool positionChanged = false;
+        if (positionPort != LV2UI_INVALID_PORT_INDEX)
+            if (AudioPlayHead* const playHead = getPlayHead())
+                positionChanged = playHead->getCurrentPosition (position) && transportChanged (position, numSamples);
+
+        if (positionPort != LV2UI_INVALID_PORT_INDEX && positionPort != midiPort)
         {
-            AudioPlayHead::CurrentPositionInfo position;
-            playHead->getCurrentPosition (position);
+            PortBuffer* const buf = module->getPortBuffer (positionPort);
+            buf->reset();
 
-            if (position.isLooping)
-            { }
-            else
-            { }
+            if (positionChanged && atomWriter->begin (*buf))
+            {
+                atomWriter->writePosition (0, position);
+                atomWriter->end();
+            }
         }
 
-        const ChannelConfig& chans (module->getChannelConfig());
-
         if (wantsMidiMessages)
         {
             PortBuffer* const buf = module->getPortBuffer (midiPort);
             buf->reset();
-            MidiBuffer::Iterator iter (midi);
-            const uint8* d = nullptr;  int s = 0, f = 0;
-            while (iter.getNextEvent (d, s, f))
-                buf->addEvent (static_cast<uint32> (f), static_cast<uint32> (s), midiEvent, d);
+
+            if (atomWriter->begin (*buf))
+            {
+                // the transport goes first so it applies to every event after it
+                if (positionChanged && positionPort == midiPort)
+                    atomWriter->writePosition (0, position);
+
+                MidiBuffer::Iterator iter (midi);
+                const uint8* d = nullptr;  int s = 0, f = 0;
+                while (iter.getNextEvent (d, s, f))
+                    atomWriter->writeMidi (f, d, static_cast<uint32> (s));
+
+                atomWriter->end();
+            }
         }
-        
+
         module->referAudioReplacing (audio);
+        module->referCVReplacing (audio, chans.getNumAudioInputs(), chans.getNumAudioOutputs());
         module->run ((uint32) numSamples);
-        midi.clear();
-
-        // if (notifyPort != LV2UI_INVALID_PORT_INDEX)
-        // {
-        //     PortBuffer* const buf = buffers.getUnchecked (notifyPort);
-        //     jassert (buf != nullptr);
-
-        //     midi.clear();
-        //     LV2_ATOM_SEQUENCE_FOREACH ((LV2_Atom_Sequence*) buf->getPortData(), ev)
-        //     {
-        //         if (ev->body.type == uris->midi_MidiEvent)
-        //         {
-        //             midi.addEvent (LV2_ATOM_BODY_CONST (&ev->body),
-        //                            ev->body.size, (int32)ev->time.frames);
-        //         }
-        //     }
-        // }
-        // else
-        // {
-        //     midi.clear();
-        // }
+
+        // MIDI, sysex included, from every output sequence. Events are decoded
+        // into a buffer reserved in prepareToPlay which is then swapped with
+        // the host's. The host's old buffer is grown at most once, so after
+        // the first block nothing allocates
+        midiOutput.clear();
+        for (const auto port : atomOutputs)
+        {
+            const auto* seq = static_cast<const LV2_Atom_Sequence*> (module->getPortBuffer (port)->getPortData());
+            LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+            {
+                if (ev->body.type == midiEvent)
+                    midiOutput.addEvent (LV2_ATOM_BODY_CONST (&ev->body), (int) ev->body.size,
+                                         jlimit (0, jmax (0, numSamples - 1), (int) ev->time.frames));
+            }
+        }
+
+        midi.swapWith (midiOutput);
+        midiOutput.ensureSize ((size_t) midiOutputSize);
+    }
+
+    /** Returns true if the plugin needs telling about the transport, which
+        is when it starts, stops, changes tempo or meter, or jumps */
+    bool transportChanged (const AudioPlayHead::CurrentPositionInfo& position, int numSamples)
+    {
+        const bool changed = position.isPlaying != lastPosition.isPlaying
+            || position.bpm != lastPosition.bpm
+            || position.timeSigNumerator != lastPosition.timeSigNumerator
+            || position.timeSigDenominator != lastPosition.timeSigDenominator
+            || position.timeInSamples != nextTimeInSamples;
+
+        lastPosition = position;
+        nextTimeInSamples = position.timeInSamples + (position.isPlaying ? numSamples : 0);
+        return changed;
     }
 
     bool hasEditor() const { return module->hasEditor(); }
@@ -422,9 +491,11 @@ public:
     const String getInputChannelName (int index) const
     {
         const ChannelConfig& chans (module->getChannelConfig());
-        if (! isPositiveAndBelow (index, chans.getNumAudioInputs()))
-            return String ("Audio In ") + String (index + 1);
-        return module->getPortName (chans.getAudioPort (index, true));
+        if (isPositiveAndBelow (index, chans.getNumAudioInputs()))
+            return module->getPortName (chans.getAudioPort (index, true));
+        if (isPositiveAndBelow (index - chans.getNumAudioInputs(), chans.getNumCVInputs()))
+            return module->getPortName (chans.getCVPort (index - chans.getNumAudioInputs(), true));
+        return String ("Audio In ") + String (index + 1);
     }
 
     bool isInputChannelStereoPair (int index) const { return false; }
@@ -432,10 +503,11 @@ public:
     const String getOutputChannelName (int index) const
     {
         const ChannelConfig& chans (module->getChannelConfig());
-        if (! isPositiveAndBelow (index, chans.getNumAudioOutputs()))
-            return String ("Audio Out ") + String (index + 1);
-
-        return module->getPortName (chans.getAudioPort (index, false));
+        if (isPositiveAndBelow (index, chans.getNumAudioOutputs()))
+            return module->getPortName (chans.getAudioPort (index, false));
+        if (isPositiveAndBelow (index - chans.getNumAudioOutputs(), chans.getNumCVOutputs()))
+            return module->getPortName (chans.getCVPort (index - chans.getNumAudioOutputs(), false));
+        return String ("Audio Out ") + String (index + 1);
     }
 
     bool isOutputChannelStereoPair (int index) const { return false; }
@@ -484,9 +556,18 @@ private:
 
     uint32 numPorts;
     uint32 midiPort;
+    uint32 positionPort;
     uint32 notifyPort;
+    uint32 latencyPort;
     uint32 atomSequence, midiEvent;
 
+    Array<uint32> atomOutputs;      ///< ports whose MIDI goes to processBlock's MidiBuffer
+    std::unique_ptr<AtomWriter> atomWriter;
+    AudioPlayHead::CurrentPositionInfo lastPosition;
+    int64 nextTimeInSamples = -1;
+    MidiBuffer midiOutput;
+    int midiOutputSize = 0;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LV2PluginInstance)
 };
 
@@ -858,6 +939,13 @@ FileSearchPath LV2PluginFormat::getDefaultLocationsToSearch()
     return paths;
 }
 
+bool setParameterValueAt (AudioProcessor* processor, int parameterIndex, float newValue, int sampleOffset)
+{
+    if (auto* const instance = dynamic_cast<LV2PluginInstance*> (processor))
+        return instance->setParameterValueAt (parameterIndex, newValue, sampleOffset);
+    return false;
+}
+
 bool LV2PluginFormat::doesPluginStillExist (const PluginDescription& desc)
 {
     StringArray plugins (searchPathsForPlugins (FileSearchPath(), true));
@@ -876,6 +964,7 @@ void LV2PluginFormat::createPluginInstance (const PluginDescription& desc, doubl
 
     if (Module* module = priv->createModule (desc.fileOrIdentifier))
     {
+        module->setMaxBlockLength ((uint32) initialBufferSize);
         Result res (module->instantiate (initialSampleRate));
         if (res.wasOk())
         {
@@ -52,4 +52,19 @@ private:
     std::unique_ptr<Internal> priv;
 };
 
+/** Set a parameter of an LV2 plugin made by LV2PluginFormat so it changes at
+    a sample offset into the next processBlock(). Use this to pass through
+    sample accurate automation; AudioProcessorParameter::setValue() always
+    lands at the start of the block.
+
+    @param processor        The plugin instance
+    @param parameterIndex   Index into processor->getParameters()
+    @param newValue         The normalised value, 0 to 1
+    @param sampleOffset     Frames into the next block
+    @returns false if processor isn't an LV2 plugin, the index is out of
+             range or the plugin's event queue is full
+ */
+JLV2_API bool setParameterValueAt (AudioProcessor* processor, int parameterIndex,
+                                   float newValue, int sampleOffset);
+
 }
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** A fixed capacity queue of small items with any number of writers and
+    readers (Vyukov's bounded MPMC queue).
+
+    Each slot carries a sequence number which says whether it's ready to
+    be written or read, so nothing locks or allocates after resize().
+ */
+template<typename ElementType>
+class MPMCQueue final
+{
+public:
+    MPMCQueue (int minCapacity = 2)     { resize (minCapacity); }
+    ~MPMCQueue() = default;
+
+    /** Set the capacity (rounded up to a power of two) and empty the queue
+        @note This is NOT realtime safe, and nothing may use the queue meanwhile */
+    void resize (int minCapacity)
+    {
+        capacity = (uint32) nextPowerOfTwo (jmax (2, minCapacity));
+        mask = capacity - 1;
+        slots.reset (new Slot [capacity]);
+        for (uint32 i = 0; i < capacity; ++i)
+            slots[i].sequence.store (i, std::memory_order_relaxed);
+        writePos.store (0, std::memory_order_relaxed);
+        readPos.store (0, std::memory_order_relaxed);
+    }
+
+    /** Returns the number of items the queue holds */
+    inline int getCapacity() const { return (int) capacity; }
+
+    /** Add an item (any thread)
+        @returns false if the queue is full */
+    inline bool push (ElementType item)
+    {
+        auto pos = writePos.load (std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[pos & mask];
+            const auto diff = (int32) (slot.sequence.load (std::memory_order_acquire) - pos);
+
+            if (diff == 0)
+            {
+                if (writePos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.item = item;
+                    slot.sequence.store (pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = writePos.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Take the oldest item (any thread)
+        @returns false if the queue is empty */
+    inline bool pop (ElementType& item)
+    {
+        auto pos = readPos.load (std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[pos & mask];
+            const auto diff = (int32) (slot.sequence.load (std::memory_order_acquire) - (pos + 1));
+
+            if (diff == 0)
+            {
+                if (readPos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = slot.item;
+                    slot.sequence.store (pos + capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = readPos.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32> sequence { 0 };
+        ElementType item {};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    uint32 capacity = 0;
+    uint32 mask = 0;
+
+    alignas (64) std::atomic<uint32> writePos { 0 };
+    alignas (64) std::atomic<uint32> readPos { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (MPMCQueue)
+};
+
+}
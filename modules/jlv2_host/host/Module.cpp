@@ -16,8 +16,9 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
-#define JLV2_MODULE_EVENT_BUFFER_SIZE   4096
-#define JLV2_MODULE_RING_BUFFER_SIZE    4096
+#define JLV2_MODULE_MAX_TIMED_CONTROLS  256
+#define JLV2_MODULE_MAX_BLOCK_LENGTH    8192
+#define JLV2_MODULE_ARENA_ALIGNMENT     64
 
 namespace jlv2 {
 
@@ -57,6 +58,24 @@ inline unsigned uiSupported (const char* hostType, const char* uiType)
 
 }
 
+/** What a Module reads about its plugin from lilv. Modules created from a
+    prototype share this instead of walking the ports again */
+class ModuleInfo : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<ModuleInfo>;
+
+    PortList ports;
+    ChannelConfig channels;
+
+    String uri;     ///< plugin URI
+    String name;    ///< Plugin name
+    String author;  ///< Plugin author name
+
+    HeapBlock<float> mins, maxes, defaults;
+    Array<uint32> minimumSizes;     ///< rsz:minimumSize of each port, 0 if not given
+};
+
 class Module::Private
 {
 public:
@@ -84,7 +103,7 @@ public:
         if (! ui && ! owner.onPortNotify)
             return;
 
-        for (const auto* port : ports.getPorts())
+        for (const auto* port : info->ports.getPorts())
         {
             if (PortType::Control != port->type)
                 continue;
@@ -104,7 +123,7 @@ public:
     {
         Module::Private* priv = static_cast<Module::Private*> (user_data);
         int portIdx = -1;
-        for (const auto* port : priv->ports.getPorts())
+        for (const auto* port : priv->info->ports.getPorts())
         {
             if (port->symbol == port_symbol && port->type == PortType::Control) {
                 portIdx = port->index;
@@ -142,7 +161,7 @@ public:
 
         int portIdx = -1;
         const PortDescription* port = nullptr;
-        for (const auto* p : priv->ports.getPorts())
+        for (const auto* p : priv->info->ports.getPorts())
         {
             port = p;
             if (port->symbol == port_symbol && port->type == PortType::Control) {
@@ -157,26 +176,383 @@ public:
                 buffer->setValue (*((float*) value));
         }
     }
+
+    /** Give every audio and CV port block sized, aligned storage: outputs
+        their own, inputs one shared silent buffer. Ports referred elsewhere
+        fall back to it when unreferred
+        @note This is NOT realtime safe */
+    void prepareScratch()
+    {
+        // whole cache lines of floats per port
+        const uint32 lineFloats = JLV2_MODULE_ARENA_ALIGNMENT / sizeof (float);
+        const uint32 frames = (maxBlockLength + lineFloats - 1) & ~(lineFloats - 1);
+
+        int numOutputs = 0;
+        for (const auto* buffer : buffers)
+            if ((buffer->isAudio() || buffer->isCV()) && ! info->ports.isInput (buffers.indexOf (buffer)))
+                ++numOutputs;
+
+        scratch.allocate ((size_t) (numOutputs + 1) * frames * sizeof (float) + JLV2_MODULE_ARENA_ALIGNMENT, true);
+        auto* const silence = reinterpret_cast<float*> (
+            (reinterpret_cast<pointer_sized_int> (scratch.getData()) + JLV2_MODULE_ARENA_ALIGNMENT - 1)
+                & ~(pointer_sized_int) (JLV2_MODULE_ARENA_ALIGNMENT - 1));
+        auto* next = silence + frames;
+
+        for (int port = 0; port < buffers.size(); ++port)
+        {
+            auto* const buffer = buffers.getUnchecked (port);
+            if (! buffer->isAudio() && ! buffer->isCV())
+                continue;
+
+            if (info->ports.isInput (port))
+            {
+                buffer->setStorage (silence, frames * sizeof (float));
+            }
+            else
+            {
+                buffer->setStorage (next, frames * sizeof (float));
+                next += frames;
+            }
+        }
+    }
+
+    /** Connect every port to its buffer. Called once after instantiation */
+    void connectAllPorts()
+    {
+        for (int i = 0; i < buffers.size(); ++i)
+            owner.connectPort (static_cast<uint32> (i), buffers.getUnchecked(i)->getPortData());
+    }
+
+    /** Apply a control value and notify listeners if it changed (realtime) */
+    void applyControl (uint32 port, float value)
+    {
+        auto* const buffer = buffers.getUnchecked ((int) port);
+        if (buffer->getValue() == value)
+            return;
+
+        buffer->setValue (value);
+
+        const int slot = controlSlots [port];
+        if (slot >= 0)
+        {
+            notifySlots.set (slot, value);
+            notifyPending = true;
+        }
+    }
+
+    /** Publish a snapshot of the control output ports (realtime) */
+    void publishControlOutputs()
+    {
+        if (controlOutputs.isEmpty())
+            return;
+
+        auto* const values = outputSnapshots.getWriteBuffer();
+        for (int i = 0; i < controlOutputs.size(); ++i)
+            values[i] = buffers.getUnchecked ((int) controlOutputs.getUnchecked (i))->getValue();
+        outputSnapshots.publish();
+    }
+
+    /** Publish the latest control values to the message thread (realtime) */
+    void publishNotifications()
+    {
+        if (! notifyPending)
+            return;
+        notifyPending = false;
+        notifySerial.fetch_add (1, std::memory_order_release);
+    }
+
+    /** Give atom and event outputs their full capacity back. Done right
+        before the plugin runs, since an output may share memory with a port
+        read earlier in a chain or graph (realtime) */
+    void resetOutputs()
+    {
+        for (const auto port : atomOutputs)
+            buffers.getUnchecked ((int) port)->reset();
+        for (const auto port : eventPorts)
+            if (! info->ports.isInput ((int) port))
+                buffers.getUnchecked ((int) port)->reset();
+    }
+
+    /** Copy each event the plugin wrote to its atom outputs into the
+        notifications ring, as atom:eventTransfer (realtime) */
+    void publishAtomOutputs (RingBuffer& ring)
+    {
+        for (const auto port : atomOutputs)
+        {
+            const auto* seq = static_cast<const LV2_Atom_Sequence*> (buffers.getUnchecked ((int) port)->getPortData());
+            LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+            {
+                PortEvent event;
+                zerostruct (event);
+                event.index         = port;
+                event.protocol      = eventTransfer;
+                event.time.frames   = ev->time.frames;
+                event.size          = (uint32) sizeof (LV2_Atom) + ev->body.size;
+
+                if (! ring.writeRecord (&event, sizeof (PortEvent), &ev->body, event.size))
+                    return;
+            }
+        }
+    }
+
+    /** Queue a control change to be applied part way into a block (realtime)
+        Changes are kept sorted by frame, in the order they were written
+        @returns false if JLV2_MODULE_MAX_TIMED_CONTROLS are already queued,
+                 in which case the change is dropped */
+    bool addTimedControl (int64 frame, uint32 port, float value)
+    {
+        if (numTimedControls >= JLV2_MODULE_MAX_TIMED_CONTROLS)
+            return false;
+
+        int i = numTimedControls++;
+        for (; i > 0 && timedControls[i - 1].frame > frame; --i)
+            timedControls[i] = timedControls[i - 1];
+
+        timedControls[i] = { frame, port, value };
+        return true;
+    }
+
+    /** Run the plugin in segments split at the queued control changes (realtime) */
+    void runSegmented (uint32 nframes)
+    {
+        for (int i = 0; i < sequencePorts.size(); ++i)
+        {
+            cursors[i] = sizeof (LV2_Atom_Sequence_Body);
+            auto* const buffer = buffers.getUnchecked ((int) sequencePorts.getUnchecked (i));
+            if (! info->ports.isInput ((int) sequencePorts.getUnchecked (i)))
+                buffer->clear();
+        }
+
+        const auto minLength = static_cast<int64> (minSegmentLength);
+        uint32 offset = 0;
+        int next = 0;
+
+        while (offset < nframes)
+        {
+            // changes belonging to a later block stay queued, even when a
+            // chunk cut short by maxBlockLength leaves less than minLength
+            const auto applyBefore = jmin (offset + minLength, (int64) nframes);
+            while (next < numTimedControls && timedControls[next].frame < applyBefore)
+            {
+                applyControl (timedControls[next].port, timedControls[next].value);
+                ++next;
+            }
+
+            uint32 end = nframes;
+            if (next < numTimedControls && timedControls[next].frame + minLength <= nframes)
+                end = static_cast<uint32> (timedControls[next].frame);
+            end = jmin (end, offset + maxBlockLength);
+
+            runSegment (offset, end - offset, end >= nframes);
+            offset = end;
+        }
+
+        // reconnect the whole block buffers
+        for (const auto port : relocatablePorts)
+            lilv_instance_connect_port (owner.instance, port, connections [port]);
+
+        // changes not reached yet are rebased on the next block
+        numTimedControls -= next;
+        for (int i = 0; i < numTimedControls; ++i)
+        {
+            timedControls[i] = timedControls[i + next];
+            timedControls[i].frame -= nframes;
+        }
+    }
+
+    /** Run a plugin which can't be segmented in maxBlockLength chunks (realtime)
+        Audio and CV ports are offset into the block. Event inputs go with the
+        first chunk and are empty for the rest, event outputs from later
+        chunks are shifted to their place in the block */
+    void runChunked (uint32 nframes)
+    {
+        for (uint32 offset = 0; offset < nframes; offset += maxBlockLength)
+        {
+            const uint32 length = jmin (maxBlockLength, nframes - offset);
+
+            for (const auto port : relocatablePorts)
+            {
+                // scratch is only one block long and its contents don't matter
+                const auto* const buffer = buffers.getUnchecked ((int) port);
+                if ((buffer->isAudio() || buffer->isCV()) && buffer->isReferenced())
+                    lilv_instance_connect_port (owner.instance, port,
+                        static_cast<float*> (buffer->getPortData()) + offset);
+            }
+
+            if (offset > 0)
+                for (const auto port : eventPorts)
+                    if (info->ports.isInput ((int) port))
+                        buffers.getUnchecked ((int) port)->clear();
+
+            for (int i = 0; i < eventPorts.size(); ++i)
+                if (! info->ports.isInput ((int) eventPorts.getUnchecked (i)))
+                    cursors[i] = static_cast<LV2_Event_Buffer*> (buffers.getUnchecked (
+                        (int) eventPorts.getUnchecked (i))->getPortData())->size;
+
+            lilv_instance_run (owner.instance, length);
+
+            if (offset == 0)
+                continue;
+
+            for (int i = 0; i < eventPorts.size(); ++i)
+            {
+                if (info->ports.isInput ((int) eventPorts.getUnchecked (i)))
+                    continue;
+
+                auto* const evbuf = static_cast<LV2_Event_Buffer*> (buffers.getUnchecked (
+                    (int) eventPorts.getUnchecked (i))->getPortData());
+                for (uint32 pos = cursors[i]; pos < evbuf->size;)
+                {
+                    auto* const ev = reinterpret_cast<LV2_Event*> (evbuf->data + pos);
+                    ev->frames += offset;
+                    pos += (sizeof (LV2_Event) + ev->size + 7) & ~7u;
+                }
+            }
+        }
+
+        // reconnect the whole block buffers
+        for (const auto port : relocatablePorts)
+            lilv_instance_connect_port (owner.instance, port, connections [port]);
+    }
+
+    /** Run one segment of a block (realtime)
+        Audio and CV ports are offset into the block, atom inputs get the events
+        which fall inside the segment and atom outputs are appended to the block's
+        output sequence */
+    void runSegment (uint32 offset, uint32 length, bool isLast)
+    {
+        for (const auto port : relocatablePorts)
+        {
+            // scratch is only one block long and its contents don't matter
+            const auto* const buffer = buffers.getUnchecked ((int) port);
+            if ((buffer->isAudio() || buffer->isCV()) && buffer->isReferenced())
+                lilv_instance_connect_port (owner.instance, port, 
+                    static_cast<float*> (buffer->getPortData()) + offset);
+        }
+
+        const auto end = static_cast<int64> (offset + length);
+
+        for (int i = 0; i < sequencePorts.size(); ++i)
+        {
+            const auto port = sequencePorts.getUnchecked (i);
+            auto* const scratch = segmentBuffers.getUnchecked (i);
+
+            if (info->ports.isInput ((int) port))
+            {
+                const auto* seq = static_cast<const LV2_Atom_Sequence*> (buffers.getUnchecked ((int) port)->getPortData());
+                const auto* body = reinterpret_cast<const uint8*> (&seq->body);
+                uint32 pos = cursors[i];
+
+                scratch->clear();
+                while (pos < seq->atom.size)
+                {
+                    const auto* ev = reinterpret_cast<const LV2_Atom_Event*> (body + pos);
+                    if (! isLast && ev->time.frames >= end)
+                        break;
+
+                    scratch->addEvent (jmax ((int64) 0, ev->time.frames - offset), ev->body.size, ev->body.type,
+                                       (const uint8*) LV2_ATOM_BODY_CONST (&ev->body));
+                    pos += sizeof (LV2_Atom_Event) + lv2_atom_pad_size (ev->body.size);
+                }
+
+                cursors[i] = pos;
+            }
+            else
+            {
+                scratch->reset();
+            }
+
+            lilv_instance_connect_port (owner.instance, port, scratch->getPortData());
+        }
+
+        lilv_instance_run (owner.instance, length);
+
+        for (int i = 0; i < sequencePorts.size(); ++i)
+        {
+            const auto port = sequencePorts.getUnchecked (i);
+            if (info->ports.isInput ((int) port))
+                continue;
+
+            auto* const buffer = buffers.getUnchecked ((int) port);
+            auto* seq = static_cast<LV2_Atom_Sequence*> (segmentBuffers.getUnchecked(i)->getPortData());
+            LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+                buffer->addEvent (ev->time.frames + offset, ev->body.size, ev->body.type,
+                                  (const uint8*) LV2_ATOM_BODY_CONST (&ev->body));
+        }
+    }
+
+    /** Reconnect ports whose buffer location changed since the last
+        cycle (realtime) */
+    void updateConnections()
+    {
+        for (const auto port : relocatablePorts)
+        {
+            auto* const data = buffers.getUnchecked ((int) port)->getPortData();
+            if (connections [port] != data)
+                owner.connectPort (port, data);
+        }
+    }
     
 private:
     friend class Module;
     Module& owner;
-    PortList ports;
-    ChannelConfig channels;
-
-    String uri;     ///< plugin URI
-    String name;    ///< Plugin name
-    String author;  ///< Plugin author name
-
+    ModuleInfo::Ptr info;
     ModuleUI::Ptr ui;
 
-    HeapBlock<float> mins, maxes, defaults;    
     OwnedArray<PortBuffer> buffers;
 
+    ControlSlots controls;              ///< latest values written to control inputs
+    HeapBlock<int> controlSlots;        ///< control slot for each port, or -1
+    Array<uint32> slotPorts;            ///< port index for each control slot
+
+    ControlSlots notifySlots;           ///< latest values applied by the audio thread
+    std::atomic<uint32> notifySerial { 0 };
+    uint32 lastNotifySerial = 0;
+    bool notifyPending = false;
+
+    Array<uint32> controlOutputs;           ///< control output ports in channel order
+    TripleBuffer<float> outputSnapshots;    ///< control output values after each run
+    HeapBlock<float> lastOutputs;           ///< output values last sent to listeners
+
+    HeapBlock<void*> connections;       ///< what each port is currently connected to
+    Array<uint32> relocatablePorts;     ///< ports which may be re-pointed with PortBuffer::referTo
+
+    struct TimedControl
+    {
+        int64  frame;
+        uint32 port;
+        float  value;
+    };
+
+    bool canSplit = true;               ///< false if the plugin uses legacy event ports
+    bool splitAtEvents = false;
+    uint32 minSegmentLength = 16;
+    uint32 maxBlockLength = JLV2_MODULE_MAX_BLOCK_LENGTH;
+    HeapBlock<TimedControl> timedControls;
+    int numTimedControls = 0;
+
+    Array<uint32> eventPorts;               ///< legacy event ports, which stop segmenting
+    Array<uint32> sequencePorts;            ///< atom ports that get split per segment
+    Array<uint32> atomOutputs;              ///< atom outputs, reset before each run and forwarded to the UI after
+    uint32 eventTransfer = 0;               ///< URID of atom:eventTransfer
+    OwnedArray<PortBuffer> segmentBuffers;  ///< scratch sequence for each of sequencePorts
+    HeapBlock<uint32> cursors;              ///< position in each sequence, or event port when chunking
+
+    uint32 workerRequestSize = 0;
+    uint32 workerResponseSize = 0;
+    HeapBlock<uint8> arena;                 ///< storage for every PortBuffer, laid out in init()
+    HeapBlock<uint8> scratch;               ///< block sized audio and CV storage, see prepareScratch()
+
     LV2_Feature instanceFeature { LV2_INSTANCE_ACCESS_URI, nullptr };
 };
 
 Module::Module (World& world_, const void* plugin_)
+   : Module (world_, plugin_, nullptr) { }
+
+Module::Module (World& world_, const Module& prototype)
+   : Module (world_, prototype.plugin, prototype.priv->info.get()) { }
+
+Module::Module (World& world_, const void* plugin_, ModuleInfo* info)
    : instance (nullptr),
      plugin ((const LilvPlugin*) plugin_),
      world (world_),
@@ -186,11 +562,18 @@ Module::Module (World& world_, const void* plugin_)
      events (nullptr)
 {
     priv = new Private (*this);
+    priv->info = info;
+    options.reset (new OptionsFeature (map (LV2_BUF_SIZE__minBlockLength),
+                                       map (LV2_BUF_SIZE__maxBlockLength),
+                                       map (LV2_ATOM__Int), 
+                                       0, JLV2_MODULE_MAX_BLOCK_LENGTH));
     init();
+    world.addModule (this);
 }
 
 Module::~Module()
 {
+    world.removeModule (this);
     freeInstance();
     worker = nullptr;
 }
@@ -200,24 +583,16 @@ void Module::activatePorts()
     // noop
 }
 
-void Module::init()
+void Module::readInfo()
 {
-    events.reset (new RingBuffer (JLV2_MODULE_RING_BUFFER_SIZE));
-    evbufsize = jmax (evbufsize, static_cast<uint32> (JLV2_MODULE_RING_BUFFER_SIZE));
-    evbuf.realloc (evbufsize);
-    evbuf.clear (evbufsize);
+    priv->info = new ModuleInfo();
+    auto& info = *priv->info;
 
-    notifications.reset (new RingBuffer (JLV2_MODULE_RING_BUFFER_SIZE));
-    ntbufsize = jmax (ntbufsize, static_cast<uint32> (JLV2_MODULE_RING_BUFFER_SIZE));
-    ntbuf.realloc (ntbufsize);
-    ntbuf.clear (ntbufsize);
+    info.mins.allocate (numPorts, true);
+    info.maxes.allocate (numPorts, true);
+    info.defaults.allocate (numPorts, true);
 
-    // create and set default port values
-    priv->mins.allocate (numPorts, true);
-    priv->maxes.allocate (numPorts, true);
-    priv->defaults.allocate (numPorts, true);
-
-    lilv_plugin_get_port_ranges_float (plugin, priv->mins, priv->maxes, priv->defaults);
+    lilv_plugin_get_port_ranges_float (plugin, info.mins, info.maxes, info.defaults);
 
     // initialize each port
     for (uint32 p = 0; p < numPorts; ++p)
@@ -243,9 +618,66 @@ void Module::init()
         lilv_node_free (nameNode); nameNode = nullptr;
         const String symbol  = lilv_node_as_string (lilv_port_get_symbol (plugin, port));
 
-        priv->ports.add (type, p, priv->ports.size (type, isInput),
-                         symbol, name, isInput);
-        priv->channels.addPort (type, p, isInput);
+        info.ports.add (type, p, info.ports.size (type, isInput),
+                        symbol, name, isInput);
+        info.channels.addPort (type, p, isInput);
+
+        uint32 minimumSize = 0;
+        if (LilvNodes* sizes = lilv_port_get_value (plugin, port, world.rsz_minimumSize))
+        {
+            if (const LilvNode* size = lilv_nodes_get_first (sizes))
+                if (lilv_node_is_int (size))
+                    minimumSize = (uint32) jmax (0, lilv_node_as_int (size));
+            lilv_nodes_free (sizes);
+        }
+        info.minimumSizes.add (minimumSize);
+    }
+
+    // load related GUIs
+    if (auto* related = lilv_plugin_get_related (plugin, world.ui_UI))
+    {
+        LILV_FOREACH (nodes, iter, related)
+        {
+            const auto* res = lilv_nodes_get (related, iter);
+            lilv_world_load_resource (world.getWorld(), res);
+        }
+        lilv_nodes_free (related);
+    }
+
+    // plugin URI
+    info.uri = String::fromUTF8 (lilv_node_as_string (lilv_plugin_get_uri (plugin)));
+
+    // plugin name
+    if (LilvNode* node = lilv_plugin_get_name (plugin))
+    {
+        info.name = String::fromUTF8 (lilv_node_as_string (node));
+        lilv_node_free (node);
+    }
+
+    // author name
+    if (LilvNode* node = lilv_plugin_get_author_name (plugin))
+    {
+        info.author = String::fromUTF8 (lilv_node_as_string (node));
+        lilv_node_free (node);
+    }
+}
+
+void Module::init()
+{
+    priv->connections.allocate (numPorts, true);
+    priv->controlSlots.allocate (numPorts, false);
+
+    if (priv->info == nullptr)
+        readInfo();
+    const auto& info = *priv->info;
+    const auto& policy = world.getBufferPolicy();
+    uint32 largestInput = 0, largestOutput = 0;
+
+    Array<uint32> capacities, dataTypes;
+    for (uint32 p = 0; p < numPorts; ++p)
+    {
+        const auto* desc = info.ports.get (p);
+        const PortType type (desc != nullptr ? desc->type : (int32) PortType::Unknown);
 
         uint32 capacity = sizeof (float);
         uint32 dataType = 0;
@@ -260,7 +692,7 @@ void Module::init()
                 dataType = map (LV2_ATOM__Float);
                 break;
             case PortType::Atom:
-                capacity = JLV2_MODULE_EVENT_BUFFER_SIZE;
+                capacity = jmax (policy.atomBufferSize, info.minimumSizes [(int) p]);
                 dataType = map (LV2_ATOM__Sequence);
                 break;
             case PortType::Midi:    
@@ -268,7 +700,7 @@ void Module::init()
                 dataType = map (LV2_MIDI__MidiEvent);
                 break;
             case PortType::Event:
-                capacity = JLV2_MODULE_EVENT_BUFFER_SIZE; 
+                capacity = jmax (policy.atomBufferSize, info.minimumSizes [(int) p]);
                 dataType = map (LV2_EVENT__Event);
                 break;
             case PortType::CV:      
@@ -277,40 +709,110 @@ void Module::init()
                 break;
         }
 
+        capacities.add (capacity);
+        dataTypes.add (dataType);
+    }
+
+    // lay out one arena for every port: control values packed together
+    // first, then each other buffer on its own cache line, then the
+    // segment scratch for each atom port
+    HeapBlock<size_t> offsets ((size_t) numPorts * 2 + 1);
+    size_t arenaSize = 0;
+    const auto place = [&] (uint32 slot, uint32 port, size_t alignment) {
+        arenaSize = (arenaSize + alignment - 1) & ~(alignment - 1);
+        offsets[slot] = arenaSize;
+        arenaSize += capacities.getUnchecked ((int) port);
+    };
+
+    for (uint32 p = 0; p < numPorts; ++p)
+        if (info.ports.getType ((int) p) == PortType::Control)
+            place (p, p, sizeof (float));
+    for (uint32 p = 0; p < numPorts; ++p)
+        if (info.ports.getType ((int) p) != PortType::Control)
+            place (p, p, JLV2_MODULE_ARENA_ALIGNMENT);
+    for (uint32 p = 0; p < numPorts; ++p)
+        if (info.ports.getType ((int) p) == PortType::Atom)
+            place (numPorts + p, p, JLV2_MODULE_ARENA_ALIGNMENT);
+
+    priv->arena.allocate (arenaSize + JLV2_MODULE_ARENA_ALIGNMENT, true);
+    auto* const arena = reinterpret_cast<uint8*> (
+        (reinterpret_cast<pointer_sized_int> (priv->arena.getData()) + JLV2_MODULE_ARENA_ALIGNMENT - 1)
+            & ~(pointer_sized_int) (JLV2_MODULE_ARENA_ALIGNMENT - 1));
+
+    // initialize each port
+    for (uint32 p = 0; p < numPorts; ++p)
+    {
+        const auto* desc = info.ports.get (p);
+        const PortType type (desc != nullptr ? desc->type : (int32) PortType::Unknown);
+        const bool isInput = desc != nullptr && desc->input;
+        const uint32 capacity = capacities.getUnchecked ((int) p);
+        const uint32 dataType = dataTypes.getUnchecked ((int) p);
+
         PortBuffer* const buf = priv->buffers.add (
-            new PortBuffer (isInput, type, dataType, capacity));
+            new PortBuffer (isInput, type, dataType, capacity, arena + offsets[p]));
         
         if (type == PortType::Control)
-            buf->setValue (priv->defaults [p]);
-    }
+            buf->setValue (info.defaults [p]);
+        else
+            priv->relocatablePorts.add (p);
 
-    // load related GUIs
-    if (auto* related = lilv_plugin_get_related (plugin, world.ui_UI))
-    {
-        LILV_FOREACH (nodes, iter, related)
+        priv->controlSlots[p] = -1;
+        if (type == PortType::Control && isInput)
         {
-            const auto* res = lilv_nodes_get (related, iter);
-            lilv_world_load_resource (world.getWorld(), res);
+            priv->controlSlots[p] = priv->slotPorts.size();
+            priv->slotPorts.add (p);
+        }
+        else if (type == PortType::Control)
+        {
+            priv->controlOutputs.add (p);
         }
-        lilv_nodes_free (related);
-    }
 
-    // plugin URI
-    priv->uri = String::fromUTF8 (lilv_node_as_string (lilv_plugin_get_uri (plugin)));
+        if (type == PortType::Atom)
+        {
+            priv->sequencePorts.add (p);
+            if (! isInput)
+                priv->atomOutputs.add (p);
+        }
+        else if (type == PortType::Event)
+        {
+            priv->eventPorts.add (p);
+            priv->canSplit = false;
+        }
 
-    // plugin name
-    if (LilvNode* node = lilv_plugin_get_name (plugin))
-    {
-        priv->name = String::fromUTF8 (lilv_node_as_string (node));
-        lilv_node_free (node);
+        if (type == PortType::Atom || type == PortType::Event)
+        {
+            auto& largest = isInput ? largestInput : largestOutput;
+            largest = jmax (largest, capacity);
+        }
     }
 
-    // author name
-    if (LilvNode* node = lilv_plugin_get_author_name (plugin))
+    priv->eventTransfer = map (LV2_ATOM__eventTransfer);
+
+    // queues only need room for a full port buffer when there are atom ports.
+    // The event queue always has a cell for each timed control a block can hold
+    events.reset (new PortEventQueue ((int) (jmax ((uint32) JLV2_MODULE_MAX_TIMED_CONTROLS, (policy.queueSize + 63) / 64)
+        + (largestInput > 0 ? PortEventQueue::getNumCellsFor (largestInput) : 0))));
+    notifications.reset (new RingBuffer ((int32) (policy.queueSize
+        + (largestOutput > 0 ? RingBuffer::getCapacityForRecord (sizeof (PortEvent) + largestOutput) : 0))));
+    priv->workerRequestSize  = policy.workerBufferSize;
+    priv->workerResponseSize = policy.workerResponseSize;
+
+    // scratch sequences for running blocks in segments
+    priv->cursors.allocate ((size_t) jmax (1, priv->sequencePorts.size(), priv->eventPorts.size()), true);
+    for (const auto port : priv->sequencePorts)
     {
-        priv->author = String::fromUTF8 (lilv_node_as_string (node));
-        lilv_node_free (node);
+        priv->segmentBuffers.add (new PortBuffer (info.ports.isInput ((int) port), PortType::Atom,
+                                                  map (LV2_ATOM__Sequence),
+                                                  priv->buffers.getUnchecked ((int) port)->getCapacity(),
+                                                  arena + offsets[port + numPorts]));
     }
+
+    priv->controls.resize (priv->slotPorts.size());
+    priv->notifySlots.resize (priv->slotPorts.size());
+    priv->outputSnapshots.resize (priv->controlOutputs.size());
+    priv->lastOutputs.malloc ((size_t) jmax (1, priv->controlOutputs.size()));
+    for (int i = 0; i < priv->controlOutputs.size(); ++i)
+        priv->lastOutputs[i] = std::numeric_limits<float>::quiet_NaN();
 }
 
 void Module::loadDefaultState()
@@ -319,7 +821,7 @@ void Module::loadDefaultState()
         return;
     
     auto* const map = (LV2_URID_Map*) world.getFeatures().getFeature (LV2_URID__map)->getFeature()->data;
-    if (auto* uriNode = lilv_new_uri (world.getWorld(), priv->uri.toRawUTF8()))
+    if (auto* uriNode = lilv_new_uri (world.getWorld(), priv->info->uri.toRawUTF8()))
     {
         if (auto* state = lilv_state_new_from_world (world.getWorld(), map, uriNode))
         {
@@ -387,6 +889,11 @@ Result Module::instantiate (double samplerate)
     features.clearQuick();
     world.getFeatures (features);
 
+    // block lengths are advertised per module
+    for (int i = 0; i < features.size(); ++i)
+        if (strcmp (features.getUnchecked(i)->URI, LV2_OPTIONS__options) == 0)
+            features.set (i, options->getFeature());
+
     // check for a worker interface
     LilvNodes* nodes = lilv_plugin_get_extension_data (plugin);
     LILV_FOREACH (nodes, iter, nodes)
@@ -394,7 +901,7 @@ Result Module::instantiate (double samplerate)
         const LilvNode* node = lilv_nodes_get (nodes, iter);
         if (lilv_node_equals (node, world.work_interface))
         {
-            worker = new WorkerFeature (world.getWorkThread(), 1);
+            worker = new WorkerFeature (world.getWorkerPool(), 1);
             features.add (worker->getFeature());
         }
     }
@@ -409,11 +916,14 @@ Result Module::instantiate (double samplerate)
         return Result::fail ("Could not instantiate plugin.");
     }
 
+    priv->prepareScratch();
+    priv->connectAllPorts();
+
     if (const void* data = getExtensionData (LV2_WORKER__interface))
     {
         if (worker == nullptr)
             return Result::fail ("Could not get worker feature whereas extension data exists.");
-        worker->setSize (2048);
+        worker->setSize (priv->workerRequestSize, priv->workerResponseSize);
         worker->setInterface (lilv_instance_get_handle (instance),
                               (LV2_Worker_Interface*) data);
     }
@@ -475,39 +985,85 @@ void Module::freeInstance()
 
 void Module::setSampleRate (double newSampleRate)
 {
-    if (newSampleRate == currentSampleRate)
+    prepare (newSampleRate, priv->maxBlockLength);
+}
+
+void Module::setMaxBlockLength (uint32 newMaxBlockLength)
+{
+    prepare (currentSampleRate, newMaxBlockLength);
+}
+
+uint32 Module::getMaxBlockLength() const { return priv->maxBlockLength; }
+
+void Module::prepare (double newSampleRate, uint32 newMaxBlockLength)
+{
+    newMaxBlockLength = jmax ((uint32) 1, newMaxBlockLength);
+    const bool blockLengthChanged = newMaxBlockLength != priv->maxBlockLength;
+    if (! blockLengthChanged && newSampleRate == currentSampleRate)
         return;
 
-    if (instance != nullptr)
+    if (blockLengthChanged)
     {
-        const bool wasActive = isActive();
-        freeInstance();
-        instantiate (newSampleRate);
+        priv->maxBlockLength = newMaxBlockLength;
+        options->setBlockLengths (0, (int) newMaxBlockLength);
+    }
 
+    if (instance != nullptr)
+    {
+        reinstantiate (newSampleRate);
         jassert (currentSampleRate == newSampleRate);
-
-        if (wasActive)
-            activate();
     }
 }
 
+void Module::reinstantiate (double samplerate)
+{
+    const bool wasActive = isActive();
+    const auto state = getStateString();
+
+    freeInstance();
+    instantiate (samplerate);
+
+    if (state.isNotEmpty())
+        setStateString (state);
+    if (wasActive)
+        activate();
+}
+
+void Module::setSampleAccurateControl (bool enabled, uint32 minSegmentLength)
+{
+    // splitting legacy event buffers isn't supported
+    if (! priv->canSplit)
+        enabled = false;
+
+    if (enabled && priv->timedControls.getData() == nullptr)
+        priv->timedControls.allocate (JLV2_MODULE_MAX_TIMED_CONTROLS, true);
+
+    priv->minSegmentLength = jmax ((uint32) 1, minSegmentLength);
+    priv->splitAtEvents = enabled;
+    if (! enabled)
+        priv->numTimedControls = 0;
+}
+
+bool Module::isSampleAccurateControl() const { return priv->splitAtEvents; }
+
 void Module::connectChannel (const PortType type, const int32 channel, void* data, const bool isInput)
 {
-    connectPort (priv->channels.getPort (type, channel, isInput), data);
+    connectPort (priv->info->channels.getPort (type, channel, isInput), data);
 }
 
 void Module::connectPort (uint32 port, void* data)
 {
+    priv->connections [port] = data;
     lilv_instance_connect_port (instance, port, data);
 }
 
-String Module::getURI()         const { return priv->uri; }
-String Module::getName()        const { return priv->name; }
-String Module::getAuthorName()  const { return priv->author; }
+String Module::getURI()         const { return priv->info->uri; }
+String Module::getName()        const { return priv->info->name; }
+String Module::getAuthorName()  const { return priv->info->author; }
 
 const ChannelConfig& Module::getChannelConfig() const
 {
-    return priv->channels;
+    return priv->info->channels;
 }
 
 String Module::getClassLabel() const
@@ -534,7 +1090,7 @@ uint32 Module::getNumPorts() const { return numPorts; }
 
 uint32 Module::getNumPorts (PortType type, bool isInput) const
 {
-    return static_cast<uint32> (priv->ports.size (type, isInput));
+    return static_cast<uint32> (priv->info->ports.size (type, isInput));
 }
 
 const LilvPort* Module::getPort (uint32 port) const
@@ -556,6 +1112,22 @@ uint32 Module::getMidiPort() const
    return LV2UI_INVALID_PORT_INDEX;
 }
 
+uint32 Module::getTimePositionPort() const
+{
+    for (uint32 i = 0; i < numPorts; ++i)
+    {
+        const LilvPort* port (getPort (i));
+        if (lilv_port_is_a (plugin, port, world.lv2_AtomPort) &&
+            lilv_port_is_a (plugin, port, world.lv2_InputPort) &&
+            lilv_port_supports_event (plugin, port, world.time_Position))
+        {
+            return i;
+        }
+    }
+
+    return LV2UI_INVALID_PORT_INDEX;
+}
+
 uint32 Module::getNotifyPort() const
 {
     for (uint32 i = 0; i < numPorts; ++i)
@@ -572,11 +1144,35 @@ uint32 Module::getNotifyPort() const
     return LV2UI_INVALID_PORT_INDEX;
 }
 
+uint32 Module::getLatencyPort() const
+{
+    return lilv_plugin_has_latency (plugin) ? lilv_plugin_get_latency_port_index (plugin)
+                                            : LV2UI_INVALID_PORT_INDEX;
+}
+
+bool Module::isInPlaceBroken() const
+{
+    return lilv_plugin_has_feature (plugin, world.lv2_inPlaceBroken);
+}
+
+uint32 Module::getPortIndexForDesignation (const String& designationURI, bool isInput) const
+{
+    uint32 index = LV2UI_INVALID_PORT_INDEX;
+    if (auto* node = lilv_new_uri (world.getWorld(), designationURI.toRawUTF8()))
+    {
+        if (const auto* port = lilv_plugin_get_port_by_designation (plugin,
+                isInput ? world.lv2_InputPort : world.lv2_OutputPort, node))
+            index = lilv_port_get_index (plugin, port);
+        lilv_node_free (node);
+    }
+    return index;
+}
+
 const LilvPlugin* Module::getPlugin() const { return plugin; }
 
 const String Module::getPortName (uint32 index) const
 {
-    if (const auto* desc = priv->ports.get (index))
+    if (const auto* desc = priv->info->ports.get (index))
         return desc->name;
     return String();
 }
@@ -586,14 +1182,14 @@ void Module::getPortRange (uint32 port, float& min, float& max, float& def) cons
     if (port >= numPorts)
         return;
 
-    min = priv->mins [port];
-    max = priv->maxes [port];
-    def = priv->defaults [port];
+    min = priv->info->mins [port];
+    max = priv->info->maxes [port];
+    def = priv->info->defaults [port];
 }
 
 PortType Module::getPortType (uint32 index) const
 {
-    if (const auto* desc = priv->ports.get (index))
+    if (const auto* desc = priv->info->ports.get (index))
         return desc->type >= PortType::Control && desc->type <= PortType::Unknown 
             ? desc->type : PortType::Unknown;
     return PortType::Unknown;
@@ -755,7 +1351,7 @@ PortBuffer* Module::getPortBuffer (uint32 port) const
 
 uint32 Module::getPortIndex (const String& symbol) const
 {
-    for (const auto* port : priv->ports.getPorts())
+    for (const auto* port : priv->info->ports.getPorts())
         if (port->symbol == symbol)
             return static_cast<uint32> (port->index);
     return LV2UI_INVALID_PORT_INDEX;
@@ -804,85 +1400,133 @@ bool Module::isPortOutput (uint32 index) const
 
 void Module::timerCallback()
 {
-    PortEvent ev;
-    
-    static const uint32 pnsize = sizeof (PortEvent);
-
-    for (;;)
+    // control values: only the latest value of each port since the last tick
+    const auto serial = priv->notifySerial.load (std::memory_order_acquire);
+    if (serial != priv->lastNotifySerial)
     {
-        if (! notifications->canRead (pnsize))
-            break;
+        priv->lastNotifySerial = serial;
+        priv->notifySlots.collect ([this] (int slot, float value) {
+            const auto port = priv->slotPorts.getUnchecked (slot);
+            if (auto ui = priv->ui)
+                ui->portEvent (port, sizeof (float), 0, &value);
+            if (onPortNotify)
+                onPortNotify (port, sizeof (float), 0, &value);
+        });
+    }
 
-        notifications->read (ev, false);
-        if (ev.size > 0 && notifications->canRead (pnsize + ev.size))
+    // control outputs written by the plugin
+    if (priv->outputSnapshots.update())
+    {
+        const auto* const values = priv->outputSnapshots.getReadBuffer();
+        for (int i = 0; i < priv->controlOutputs.size(); ++i)
         {
-            notifications->advance (pnsize, false);
-            notifications->read (ntbuf, ev.size, true);
+            if (values[i] == priv->lastOutputs[i])
+                continue;
 
-            if (ev.protocol == 0)
-            {
-                if (auto ui = priv->ui)
-                    ui->portEvent (ev.index, ev.size, ev.protocol, ntbuf.getData());
-                if (onPortNotify)
-                    onPortNotify (ev.index, ev.size, ev.protocol, ntbuf.getData());
-            }
+            priv->lastOutputs[i] = values[i];
+            const auto port = priv->controlOutputs.getUnchecked (i);
+            if (auto ui = priv->ui)
+                ui->portEvent (port, sizeof (float), 0, &values[i]);
+            if (onPortNotify)
+                onPortNotify (port, sizeof (float), 0, &values[i]);
         }
     }
+
+    // events from atom outputs
+    notifications->readRecords ([this] (const uint8* data, uint32 size) {
+        PortEvent ev;
+        jassert (size >= sizeof (PortEvent));
+        memcpy (&ev, data, sizeof (PortEvent));
+        if (auto ui = priv->ui)
+            ui->portEvent (ev.index, ev.size, ev.protocol, data + sizeof (PortEvent));
+        if (onPortNotify)
+            onPortNotify (ev.index, ev.size, ev.protocol, data + sizeof (PortEvent));
+    });
 }
 
 void Module::referAudioReplacing (AudioSampleBuffer& buffer)
 {
-    for (int c = 0; c < priv->channels.getNumAudioInputs(); ++c)
-        priv->buffers.getUnchecked ((int) priv->channels.getPort (
-            PortType::Audio, c, true))->referTo (buffer.getWritePointer (c));
+    // ports past the buffer's channels fall back to their scratch
+    const int numChannels = buffer.getNumChannels();
+
+    for (int c = 0; c < priv->info->channels.getNumAudioInputs(); ++c)
+        priv->buffers.getUnchecked ((int) priv->info->channels.getPort (
+            PortType::Audio, c, true))->referTo (c < numChannels ? buffer.getWritePointer (c) : nullptr);
+
+    for (int c = 0; c < priv->info->channels.getNumAudioOutputs(); ++c)
+        priv->buffers.getUnchecked ((int) priv->info->channels.getPort (
+            PortType::Audio, c, false))->referTo (c < numChannels ? buffer.getWritePointer (c) : nullptr);
+}
+
+void Module::referCVReplacing (AudioSampleBuffer& buffer, int firstInput, int firstOutput)
+{
+    const int numChannels = buffer.getNumChannels();
+    const auto& channels = priv->info->channels;
+
+    for (int c = 0; c < channels.getNumCVInputs(); ++c)
+        priv->buffers.getUnchecked ((int) channels.getCVPort (c, true))->referTo (
+            firstInput + c < numChannels ? buffer.getWritePointer (firstInput + c) : nullptr);
 
-    for (int c = 0; c < priv->channels.getNumAudioOutputs(); ++c)
-        priv->buffers.getUnchecked ((int) priv->channels.getPort (
-            PortType::Audio, c, false))->referTo (buffer.getWritePointer (c));
+    for (int c = 0; c < channels.getNumCVOutputs(); ++c)
+        priv->buffers.getUnchecked ((int) channels.getCVPort (c, false))->referTo (
+            firstOutput + c < numChannels ? buffer.getWritePointer (firstOutput + c) : nullptr);
 }
 
 void Module::run (uint32 nframes)
 {
-    PortEvent ev;
-    
-    static const uint32 pesize = sizeof (PortEvent);
+    priv->controls.collect ([this] (int slot, float value) {
+        priv->applyControl (priv->slotPorts.getUnchecked (slot), value);
+    });
 
-    for (;;)
-    {
-        if (! events->canRead (pesize))
-            break;
-        events->read (ev, false);
-        if (ev.size > 0 && events->canRead (pesize + ev.size))
+    events->read ([this] (const PortEvent& ev, const void* data) {
+        if (ev.protocol == 0 && ev.size == sizeof (float))
         {
-            events->advance (pesize, false);
-            events->read (evbuf, ev.size, true);
-
-            if (ev.protocol == 0)
+            const float value = *static_cast<const float*> (data);
+            if (priv->splitAtEvents && ev.time.frames > 0)
             {
-                auto* buffer = priv->buffers.getUnchecked (ev.index);                
-                if (buffer->getValue() != *((float*) evbuf.getData()))
-                {
-                    buffer->setValue (*((float*) evbuf.getData()));
-                    if (notifications->canWrite (pesize + ev.size)) 
-                    {
-                        notifications->write (ev);
-                        notifications->write (evbuf.getData(), ev.size);
-                    }
-                }
+                if (! priv->addTimedControl (ev.time.frames, ev.index, value))
+                    events->countDrop();
             }
+            else
+                priv->applyControl (ev.index, value);
         }
-    }
+    });
+
+    priv->updateConnections();
+    priv->resetOutputs();
 
-    for (int i = priv->buffers.size(); --i >= 0;)
-        connectPort (static_cast<uint32> (i), priv->buffers.getUnchecked(i)->getPortData());
-    
     if (worker)
         worker->processWorkResponses();
 
-    lilv_instance_run (instance, nframes);
+    if (nframes > 0 && priv->canSplit && (priv->numTimedControls > 0 || nframes > priv->maxBlockLength))
+        priv->runSegmented (nframes);
+    else if (nframes > priv->maxBlockLength)
+        priv->runChunked (nframes);
+    else
+        lilv_instance_run (instance, nframes);
 
     if (worker)
         worker->endRun();
+
+    priv->publishControlOutputs();
+    priv->publishNotifications();
+    priv->publishAtomOutputs (*notifications);
+}
+
+void Module::getControlOutputValues (float* values, int numValues) const
+{
+    // the timer is the snapshot's only reader, this copies what it last picked up
+    const auto* const latest = priv->outputSnapshots.getReadBuffer();
+    for (int i = 0; i < jmin (numValues, priv->controlOutputs.size()); ++i)
+        values[i] = latest[i];
+}
+
+QueueStats Module::getEventStats() const           { return events->getStats(); }
+QueueStats Module::getNotificationStats() const    { return notifications->getStats(); }
+
+QueueStats Module::getWorkResponseStats() const
+{
+    return worker != nullptr ? worker->getResponseStats() : QueueStats();
 }
 
 uint32 Module::map (const String& uri) const
@@ -891,23 +1535,32 @@ uint32 Module::map (const String& uri) const
     return (const_cast<World*> (&world))->map (uri);
 }
 
-void Module::write (uint32 port, uint32 size, uint32 protocol, const void* buffer)
+bool Module::write (uint32 port, uint32 size, uint32 protocol, const void* buffer, int64 frame)
 {
+    // plain control values bypass the ring buffer
+    if (protocol == 0 && size == sizeof (float) && port < numPorts && 
+        (frame <= 0 || ! priv->splitAtEvents))
+    {
+        const int slot = priv->controlSlots [port];
+        if (slot >= 0)
+        {
+            priv->controls.set (slot, *static_cast<const float*> (buffer));
+            return true;
+        }
+    }
+
     PortEvent event;
     zerostruct (event);
-    event.index     = port;
-    event.size      = size;
-    event.protocol  = protocol;
+    event.index         = port;
+    event.size          = size;
+    event.protocol      = protocol;
+    event.time.frames   = frame;
 
-    if (events->canWrite (sizeof (PortEvent) + size))
-    {
-        events->write (event);
-        events->write (buffer, event.size);
-    }
-    else
-    {
-        DBG("lv2 plugin write buffer full.");
-    }
+    if (events->write (event, buffer))
+        return true;
+
+    DBG("lv2 plugin write buffer full.");
+    return false;
 }
 
 }
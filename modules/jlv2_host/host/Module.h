@@ -82,16 +82,23 @@ struct SupportedUI
     bool useShowInterface { false };
 };
 
+class ModuleInfo;
+
 /** A wrapper around LilvPlugin/LilvInstance for running LV2 plugins
     Methods that are realtime/thread safe are excplicity documented as so.
     All other methods are NOT realtime safe
  */
-class Module : private Timer
+class JLV2_API Module : private Timer
 {
 public:
     /** Create a new Module */
     Module (World& world, const void* plugin_);
 
+    /** Create a Module for the same plugin as another. Port and plugin
+        descriptions are shared with the prototype instead of being read
+        from lilv again */
+    Module (World& world, const Module& prototype);
+
     /** Destructor */
     ~Module();
 
@@ -117,6 +124,10 @@ public:
     /** Get the port intended to be used as a MIDI input */
     uint32 getMidiPort() const;
 
+    /** Get the atom input which takes time:Position objects, if any. This
+        may be the same port as getMidiPort() */
+    uint32 getTimePositionPort() const;
+
     /** Get the plugin's name */
     String getName() const;
 
@@ -124,6 +135,17 @@ public:
         used as a MIDI output */
     uint32 getNotifyPort() const;
 
+    /** Get the control output port which reports latency, if any */
+    uint32 getLatencyPort() const;
+
+    /** Get the port with an lv2:designation, e.g. LV2_CORE__freeWheeling
+        @returns The port index or LV2UI_INVALID_PORT_INDEX if not found */
+    uint32 getPortIndexForDesignation (const String& designationURI, bool isInput = true) const;
+
+    /** Returns true if the plugin requires lv2:inPlaceBroken, e.g. its
+        audio inputs and outputs must not share a buffer */
+    bool isInPlaceBroken() const;
+
     /** Get the underlying LV2_Handle */
     void* getHandle();
 
@@ -185,6 +207,23 @@ public:
      */
     void setSampleRate (double newSampleRate);
 
+    /** Set the largest block the plugin will be run with
+        This is advertised to the plugin as bufsz:maxBlockLength. Longer blocks
+        passed to run() are processed in chunks no larger than this.
+        @param maxBlockLength The largest number of frames per lilv run
+        @note This will re-instantiate the plugin if the length changed
+     */
+    void setMaxBlockLength (uint32 maxBlockLength);
+
+    /** Returns the largest block the plugin is run with */
+    uint32 getMaxBlockLength() const;
+
+    /** Set the sample rate and largest block length together
+        @note This re-instantiates the plugin at most once, and only if
+              either of them changed
+     */
+    void prepare (double newSampleRate, uint32 newMaxBlockLength);
+
     //=========================================================================
 
     /** Get the plugin's extension data
@@ -225,9 +264,31 @@ public:
         @param nframes The number of samples to process
         @note If you need to process events only, then call this method 
               with nframes = 0.
+        @note Blocks longer than getMaxBlockLength() are run in chunks.
+        @note Ports are connected once when instantiated. Only ports whose
+              PortBuffer was re-pointed (e.g. by referAudioReplacing) get
+              reconnected here.
+        @note Atom and event outputs are emptied before the plugin runs, so
+              callers don't need to reset them.
       */
     void run (uint32 nframes);
 
+    /** Split run() at the timestamps of queued control changes
+        When enabled, control values written with a frame offset take effect
+        at that offset by running the plugin in segments, instead of at the
+        start of the block.
+        @param enabled          True to split blocks at control changes
+        @param minSegmentLength Changes closer together than this get applied
+                                at the same segment boundary, so no segment is
+                                shorter except for the tail of a block
+        @note Has no effect on plugins with legacy LV2 Event ports. This is
+              NOT realtime safe
+     */
+    void setSampleAccurateControl (bool enabled, uint32 minSegmentLength = 16);
+
+    /** Returns true if run() splits blocks at control change timestamps */
+    bool isSampleAccurateControl() const;
+
     /** Connect a port to a data location (realtime)
         @param port The port index to connect
         @param data A pointer to the port buffer that should be used
@@ -240,12 +301,40 @@ public:
       */
     void connectChannel (const PortType type, const int32 channel, void* data, const bool isInput);
 
-    /** Connect an audio buffer setup for in place processing (realtime) */
+    /** Connect an audio buffer setup for in place processing (realtime)
+        Ports past the buffer's last channel use the module's own scratch */
     void referAudioReplacing (AudioSampleBuffer&);
 
+    /** Connect CV ports to channels of a buffer, zero-copy (realtime)
+        CV input n reads channel firstInput + n and CV output n writes
+        channel firstOutput + n. Ports past the buffer's last channel use
+        the module's own scratch */
+    void referCVReplacing (AudioSampleBuffer&, int firstInput, int firstOutput);
+
     /** Returns a port buffer for port index (realtime) */    
     PortBuffer* getPortBuffer (uint32) const;
 
+    /** Copies the values of the control output ports as of the last timer
+        tick (up to 1/60th of a second behind run()), in control output
+        channel order. This never blocks the audio thread, and is intended
+        for polling meters and the like.
+        @note Call this from the message thread only
+     */
+    void getControlOutputValues (float* values, int numValues) const;
+
+    /** Returns the traffic through the queue of port events into run().
+        Timed control values dropped because too many were pending count as
+        drops here too */
+    QueueStats getEventStats() const;
+
+    /** Returns the traffic through the queue of atom output events sent on to the UI */
+    QueueStats getNotificationStats() const;
+
+    /** Returns the traffic through the worker's responses, or empty stats if
+        the plugin has no worker
+        @note Call this from the message thread only */
+    QueueStats getWorkResponseStats() const;
+
     //=========================================================================
 
     /** Loads the default state if available */
@@ -262,9 +351,18 @@ public:
     //=========================================================================
 
     /** Write some data to a port
-        This will send a PortEvent to the audio thread
+        Control values are stored in a lock-free slot per port and applied
+        by the next run(). Anything else (atoms, UI messages, timestamped
+        control values) is sent to the audio thread as a PortEvent.
+        Any number of threads may write at once.
+        @param frame Offset into the next block at which a control value
+                     should take effect. Only used when sample accurate
+                     control is enabled, otherwise values are applied at
+                     the start of the block
+        @returns false if the event queue was full and the write was dropped.
+                 Untimed control values always succeed
      */
-    void write (uint32 port, uint32 size, uint32 protocol, const void* buffer);
+    bool write (uint32 port, uint32 size, uint32 protocol, const void* buffer, int64 frame = 0);
 
     /** Send port values to listeners now */
     void sendPortEvents();
@@ -284,20 +382,22 @@ private:
     uint32 numPorts;
     Array<const LV2_Feature*> features;
 
-    std::unique_ptr<RingBuffer> events;
-    HeapBlock<uint8> evbuf;
-    uint32 evbufsize;
+    std::unique_ptr<PortEventQueue> events;
 
     std::unique_ptr<RingBuffer> notifications;
-    HeapBlock<uint8> ntbuf;
-    uint32 ntbufsize;
 
     OwnedArray<SupportedUI> supportedUIs;
     OwnedArray<ScalePoints> scalePoints;
 
+    std::unique_ptr<OptionsFeature> options;
+
+    Module (World& world, const void* plugin_, ModuleInfo* info);
+
     void activatePorts();
     void freeInstance();
     void init();
+    void readInfo();
+    void reinstantiate (double samplerate);
     
     void timerCallback() override;
 
@@ -309,7 +409,7 @@ private:
     bool isLoaded() const;
 };
 
-class ModuleUI final : public ReferenceCountedObject
+class JLV2_API ModuleUI final : public ReferenceCountedObject
 {
 public:
     using Ptr = ReferenceCountedObjectPtr<ModuleUI>;
@@ -0,0 +1,209 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+namespace jlv2 {
+
+ModuleChain::ModuleChain() { }
+
+ModuleChain::~ModuleChain()
+{
+    clear();
+}
+
+Module* ModuleChain::add (Module* module)
+{
+    jassert (module != nullptr);
+    Stage stage;
+    stage.module = modules.add (module);
+    stages.add (stage);
+    return module;
+}
+
+void ModuleChain::clear()
+{
+    stages.clearQuick();
+    modules.clear();
+    planner.clear();
+    blockSize = 0;
+}
+
+PortBuffer* ModuleChain::getAudioBuffer (Module& module, int channel, bool isInput)
+{
+    return module.getPortBuffer (module.getChannelConfig().getPort (PortType::Audio, channel, isInput));
+}
+
+float* ModuleChain::getScratch (int index)
+{
+    switch (index)
+    {
+        case silentBuffer: return silence.getData();
+        case sinkBuffer:   return sink.getData();
+        default: break;
+    }
+
+    return static_cast<float*> (planner.getBuffer (index));
+}
+
+void ModuleChain::prepare (int maxBlockSize)
+{
+    blockSize = jmax (1, maxBlockSize);
+    planner.clear();
+
+    // stage s reads its inputs at step 2s and writes at 2s + 1 if it can
+    // process in place, so its outputs may take over its inputs' buffers
+    const int endStep = stages.size() * 2;
+    const uint32 audioSize = (uint32) blockSize * sizeof (float);
+    Array<int> previous;
+    int previousAtom = -1;
+
+    for (int s = 0; s < stages.size(); ++s)
+    {
+        auto& stage = stages.getReference (s);
+        auto& module = *stage.module;
+        const auto& channels = module.getChannelConfig();
+        const bool isLast  = s == stages.size() - 1;
+        const bool inPlace = ! module.isInPlaceBroken();
+        const int numIns   = channels.getNumAudioInputs();
+        const int numOuts  = channels.getNumAudioOutputs();
+        const int numRead  = isLast ? 0 : stages.getReference (s + 1).module->getChannelConfig().getNumAudioInputs();
+        const int readStep = s * 2;
+
+        stage.audioIns.clearQuick();
+        for (int c = 0; c < numIns; ++c)
+        {
+            const int index = s == 0 ? (int) externalBuffer
+                                     : (c < previous.size() ? previous.getUnchecked (c) : (int) silentBuffer);
+            if (index >= 0)
+                planner.use (index, readStep);
+            stage.audioIns.add (index);
+        }
+
+        stage.audioOuts.clearQuick();
+        for (int c = 0; c < numOuts; ++c)
+        {
+            int index = sinkBuffer;
+
+            if (isLast && (s > 0 || inPlace))
+                index = externalBuffer;
+            else if (isLast)
+                index = planner.add (audioSize, readStep, endStep);    // copied out after the run
+            else if (c < numRead)
+                index = planner.add (audioSize, inPlace ? readStep + 1 : readStep, readStep + 1);
+
+            stage.audioOuts.add (index);
+        }
+
+        previous = stage.audioOuts;
+
+        stage.atomIn = stage.atomOut = nullptr;
+        const auto midiPort = module.getMidiPort();
+        if (midiPort != LV2UI_INVALID_PORT_INDEX && module.getPortType (midiPort) == PortType::Atom)
+            stage.atomIn = module.getPortBuffer (midiPort);
+        const auto notifyPort = module.getNotifyPort();
+        if (notifyPort != LV2UI_INVALID_PORT_INDEX && module.getPortType (notifyPort) == PortType::Atom)
+            stage.atomOut = module.getPortBuffer (notifyPort);
+
+        if (stage.atomIn != nullptr && previousAtom >= 0)
+            planner.use (previousAtom, readStep);
+
+        // outputs are reset before the run, so never in place. The last
+        // one keeps its own buffer for getAtomOutput()
+        stage.atomValue = -1;
+        if (stage.atomOut != nullptr && ! isLast)
+        {
+            stage.atomOut->referTo (nullptr);
+            stage.atomValue = planner.add (stage.atomOut->getCapacity(), readStep, readStep);
+        }
+
+        previousAtom = stage.atomValue;
+    }
+
+    planner.plan();
+    silence.calloc ((size_t) blockSize);
+    sink.calloc ((size_t) blockSize);
+
+    // everything but the ends of the chain stays put between blocks
+    for (int s = 0; s < stages.size(); ++s)
+    {
+        auto& stage = stages.getReference (s);
+
+        for (int c = 0; c < stage.audioIns.size(); ++c)
+            if (stage.audioIns.getUnchecked (c) != externalBuffer)
+                getAudioBuffer (*stage.module, c, true)->referTo (getScratch (stage.audioIns.getUnchecked (c)));
+
+        for (int c = 0; c < stage.audioOuts.size(); ++c)
+            if (stage.audioOuts.getUnchecked (c) != externalBuffer)
+                getAudioBuffer (*stage.module, c, false)->referTo (getScratch (stage.audioOuts.getUnchecked (c)));
+
+        if (stage.atomValue >= 0)
+            stage.atomOut->referTo (planner.getBuffer (stage.atomValue));
+
+        if (s > 0 && stage.atomIn != nullptr)
+        {
+            if (auto* const feed = stages.getReference (s - 1).atomOut)
+                stage.atomIn->referTo (feed->getPortData());
+            else
+                stage.atomIn->reset();
+        }
+    }
+}
+
+void ModuleChain::process (AudioSampleBuffer& audio)
+{
+    jassert (audio.getNumSamples() <= blockSize);
+    const int numFrames   = jmin (audio.getNumSamples(), blockSize);
+    const int numChannels = audio.getNumChannels();
+
+    if (stages.isEmpty() || numFrames <= 0)
+        return;
+
+    auto& first = stages.getReference (0);
+    for (int c = 0; c < first.audioIns.size(); ++c)
+        getAudioBuffer (*first.module, c, true)->referTo (
+            c < numChannels ? audio.getWritePointer (c) : silence.getData());
+
+    auto& last = stages.getReference (stages.size() - 1);
+    for (int c = 0; c < last.audioOuts.size(); ++c)
+        if (last.audioOuts.getUnchecked (c) == externalBuffer)
+            getAudioBuffer (*last.module, c, false)->referTo (
+                c < numChannels ? audio.getWritePointer (c) : sink.getData());
+
+    for (auto& stage : stages)
+        stage.module->run (static_cast<uint32> (numFrames));
+
+    // a single inPlaceBroken module renders to scratch
+    for (int c = 0; c < jmin (numChannels, last.audioOuts.size()); ++c)
+        if (last.audioOuts.getUnchecked (c) >= 0)
+            FloatVectorOperations::copy (audio.getWritePointer (c),
+                getScratch (last.audioOuts.getUnchecked (c)), numFrames);
+
+    for (int c = last.audioOuts.size(); c < numChannels; ++c)
+        audio.clear (c, 0, numFrames);
+}
+
+PortBuffer* ModuleChain::getAtomInput() const
+{
+    return stages.isEmpty() ? nullptr : stages.getReference(0).atomIn;
+}
+
+PortBuffer* ModuleChain::getAtomOutput() const
+{
+    return stages.isEmpty() ? nullptr : stages.getReference(stages.size() - 1).atomOut;
+}
+
+}
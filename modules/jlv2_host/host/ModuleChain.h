@@ -0,0 +1,103 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Runs a series of Modules back to back without copying between them.
+
+    Audio output N of each module is connected straight to audio input N of
+    the next, and the notify (MIDI out) port of each module to the MIDI input
+    of the next, by pointing their PortBuffers at the same memory. A
+    BufferPlanner hands out the audio and atom buffers between modules by
+    lifetime, so a buffer is reused as soon as the module reading it has
+    run. Modules which aren't lv2:inPlaceBroken process in place.
+ */
+class JLV2_API ModuleChain final
+{
+public:
+    ModuleChain();
+    ~ModuleChain();
+
+    /** Add an instantiated module to the end of the chain. The chain takes
+        ownership. Call prepare() before processing again */
+    Module* add (Module* module);
+
+    /** Delete all modules */
+    void clear();
+
+    /** Returns the number of modules in the chain */
+    inline int size() const { return modules.size(); }
+
+    /** Returns a module by index */
+    inline Module* getModule (int index) const { return modules [index]; }
+
+    /** Allocate scratch buffers and connect the modules to each other
+        @param maxBlockSize The largest block process() will be called with
+        @note This is NOT realtime safe
+     */
+    void prepare (int maxBlockSize);
+
+    /** Process a block in place through every module (realtime)
+        Channels of the buffer feed the first module's audio inputs and
+        receive the last module's audio outputs. Channels the last module
+        doesn't write are cleared.
+        @note The block must not be longer than the size given to prepare()
+     */
+    void process (AudioSampleBuffer& audio);
+
+    /** Returns the MIDI input buffer of the first module, or nullptr. Fill
+        this before calling process() */
+    PortBuffer* getAtomInput() const;
+
+    /** Returns the notify buffer of the last module, or nullptr. This holds
+        the last module's output after process() */
+    PortBuffer* getAtomOutput() const;
+
+private:
+    enum BufferIndex
+    {
+        externalBuffer = -1,    ///< the buffer passed to process()
+        silentBuffer   = -2,    ///< zeros, for inputs nothing feeds
+        sinkBuffer     = -3     ///< for outputs nothing reads
+    };
+
+    struct Stage
+    {
+        Module* module = nullptr;
+        Array<int> audioIns, audioOuts;     ///< planned value or BufferIndex per channel
+        PortBuffer* atomIn  = nullptr;
+        PortBuffer* atomOut = nullptr;
+        int atomValue = -1;                 ///< planned value of atomOut, if any
+    };
+
+    OwnedArray<Module> modules;
+    Array<Stage> stages;
+    int blockSize = 0;
+
+    BufferPlanner planner;
+    HeapBlock<float> silence, sink;
+
+    float* getScratch (int index);
+    static PortBuffer* getAudioBuffer (Module&, int channel, bool isInput);
+
+    JUCE_DECLARE_NON_COPYABLE (ModuleChain)
+};
+
+}
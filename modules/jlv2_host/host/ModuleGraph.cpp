@@ -0,0 +1,507 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+namespace jlv2 {
+
+struct ModuleGraph::Node
+{
+    Node (Module* m) : module (m) { }
+
+    std::unique_ptr<Module> module;
+    Array<int> dependents;              ///< nodes fed by this one
+    int numDependencies = 0;            ///< nodes feeding this one
+    Array<int> outputValues;            ///< planned value of each audio output
+    PortBuffer* atomOut = nullptr;
+    int atomValue = -1;                 ///< planned value of atomOut
+
+    std::atomic<int> pending { 0 };     ///< feeding nodes yet to run this block
+    std::atomic<int64> lastTicks { 0 };
+    std::atomic<int64> peakTicks { 0 };
+    std::atomic<int> thread { -1 };
+};
+
+/** A realtime thread which helps with each block, then sleeps */
+class ModuleGraph::Worker : public Thread
+{
+public:
+    Worker (ModuleGraph& g, int i)
+        : Thread ("jlv2: graph " + String (i)),
+          graph (g), index (i) { }
+
+    ~Worker()
+    {
+        signalThreadShouldExit();
+        wake.signal();
+        stopThread (2000);
+    }
+
+    inline void signal() { wake.signal(); }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wake.wait();
+            if (threadShouldExit())
+                break;
+            graph.work (index);
+        }
+    }
+
+private:
+    ModuleGraph& graph;
+    const int index;
+    WaitableEvent wake;
+};
+
+//=============================================================================
+ModuleGraph::ModuleGraph()
+{
+    setNumThreads (1);
+}
+
+ModuleGraph::~ModuleGraph()
+{
+    workers.clear();
+    clear();
+}
+
+int ModuleGraph::addNode (Module* module)
+{
+    jassert (module != nullptr);
+    nodes.add (new Node (module));
+    return nodes.size() - 1;
+}
+
+Module* ModuleGraph::getModule (int node) const
+{
+    return isPositiveAndBelow (node, nodes.size()) ? nodes.getUnchecked(node)->module.get() : nullptr;
+}
+
+bool ModuleGraph::isValidChannel (int node, int channel, bool isInput) const
+{
+    return isPositiveAndBelow (node, nodes.size()) &&
+        isPositiveAndBelow (channel, nodes.getUnchecked(node)->module->getChannelConfig()
+                                        .getNumChannels (PortType::Audio, isInput));
+}
+
+bool ModuleGraph::isInputConnected (int node, int channel) const
+{
+    for (const auto& c : audioConnections)
+        if (c.destNode == node && c.destChannel == channel)
+            return true;
+    return false;
+}
+
+bool ModuleGraph::connect (int sourceNode, int sourceChannel, int destNode, int destChannel)
+{
+    if (sourceNode == destNode || ! isValidChannel (sourceNode, sourceChannel, false) ||
+        ! isValidChannel (destNode, destChannel, true) || isInputConnected (destNode, destChannel))
+        return false;
+
+    audioConnections.add ({ sourceNode, sourceChannel, destNode, destChannel });
+    return true;
+}
+
+bool ModuleGraph::connectMidi (int sourceNode, int destNode)
+{
+    if (sourceNode == destNode || ! isPositiveAndBelow (sourceNode, nodes.size()) ||
+        ! isPositiveAndBelow (destNode, nodes.size()))
+        return false;
+
+    const auto& source = *nodes.getUnchecked(sourceNode)->module;
+    const auto& dest   = *nodes.getUnchecked(destNode)->module;
+    const auto notifyPort = source.getNotifyPort();
+    const auto midiPort   = dest.getMidiPort();
+
+    if (notifyPort == LV2UI_INVALID_PORT_INDEX || source.getPortType (notifyPort) != PortType::Atom ||
+        midiPort == LV2UI_INVALID_PORT_INDEX || dest.getPortType (midiPort) != PortType::Atom)
+        return false;
+
+    for (const auto& c : midiConnections)
+        if (c.destNode == destNode)
+            return false;
+
+    midiConnections.add ({ sourceNode, 0, destNode, 0 });
+    return true;
+}
+
+bool ModuleGraph::connectInput (int channel, int destNode, int destChannel)
+{
+    if (channel < 0 || ! isValidChannel (destNode, destChannel, true) ||
+        isInputConnected (destNode, destChannel))
+        return false;
+
+    audioConnections.add ({ -1, channel, destNode, destChannel });
+    return true;
+}
+
+bool ModuleGraph::connectOutput (int sourceNode, int sourceChannel, int channel)
+{
+    if (channel < 0 || ! isValidChannel (sourceNode, sourceChannel, false))
+        return false;
+
+    for (const auto& c : audioConnections)
+        if (c.sourceNode == sourceNode && c.sourceChannel == sourceChannel &&
+            c.destNode < 0 && c.destChannel == channel)
+            return false;
+
+    audioConnections.add ({ sourceNode, sourceChannel, -1, channel });
+    return true;
+}
+
+void ModuleGraph::clear()
+{
+    audioConnections.clearQuick();
+    midiConnections.clearQuick();
+    graphInputs.clearQuick();
+    graphOutputs.clearQuick();
+    roots.clearQuick();
+    nodes.clear();
+    planner.clear();
+}
+
+void ModuleGraph::setNumThreads (int numThreads)
+{
+    numThreads = jmax (1, numThreads);
+    workers.clear();
+    deques.clear();
+
+    for (int i = 0; i < numThreads; ++i)
+        deques.add (new WorkStealingDeque<int>())->resize (nodes.size());
+
+    for (int i = 1; i < numThreads; ++i)
+        workers.add (new Worker (*this, i))->startThread (9);
+}
+
+float* ModuleGraph::getOutputBuffer (int node, int channel)
+{
+    return static_cast<float*> (planner.getBuffer (nodes.getUnchecked(node)->outputValues.getUnchecked (channel)));
+}
+
+Result ModuleGraph::prepare (int maxBlockSize)
+{
+    blockSize = jmax (1, maxBlockSize);
+
+    for (auto* node : nodes)
+    {
+        auto& module = *node->module;
+        node->dependents.clearQuick();
+        node->numDependencies = 0;
+
+        const auto notifyPort = module.getNotifyPort();
+        node->atomOut = notifyPort != LV2UI_INVALID_PORT_INDEX && module.getPortType (notifyPort) == PortType::Atom
+                      ? module.getPortBuffer (notifyPort) : nullptr;
+    }
+
+    auto addDependency = [this] (int source, int dest)
+    {
+        if (source < 0 || dest < 0)
+            return;
+        auto& dependents = nodes.getUnchecked(source)->dependents;
+        if (dependents.addIfNotAlreadyThere (dest))
+            ++nodes.getUnchecked(dest)->numDependencies;
+    };
+
+    for (const auto& c : audioConnections)
+        addDependency (c.sourceNode, c.destNode);
+    for (const auto& c : midiConnections)
+        addDependency (c.sourceNode, c.destNode);
+
+    // Kahn's algorithm, to find the roots and an order, and reject cycles
+    Array<int> counts, ready, order;
+    roots.clearQuick();
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        counts.add (nodes.getUnchecked(i)->numDependencies);
+        if (counts.getLast() == 0)
+            roots.add (i);
+    }
+
+    ready = roots;
+    int numVisited = 0;
+    while (! ready.isEmpty())
+    {
+        const int node = ready.removeAndReturn (ready.size() - 1);
+        order.add (node);
+        ++numVisited;
+        for (const auto dependent : nodes.getUnchecked(node)->dependents)
+            if (--counts.getReference (dependent) == 0)
+                ready.add (dependent);
+    }
+
+    if (numVisited < nodes.size())
+    {
+        roots.clearQuick();
+        return Result::fail ("the graph contains a cycle");
+    }
+
+    planBuffers (order);
+    silence.calloc ((size_t) blockSize);
+
+    for (int n = 0; n < nodes.size(); ++n)
+    {
+        auto& node = *nodes.getUnchecked (n);
+        auto& module = *node.module;
+        const auto& channels = module.getChannelConfig();
+
+        for (int c = 0; c < channels.getNumAudioOutputs(); ++c)
+            module.getPortBuffer (channels.getPort (PortType::Audio, c, false))->referTo (getOutputBuffer (n, c));
+        for (int c = 0; c < channels.getNumAudioInputs(); ++c)
+            module.getPortBuffer (channels.getPort (PortType::Audio, c, true))->referTo (silence.getData());
+        if (node.atomOut != nullptr)
+            node.atomOut->referTo (planner.getBuffer (node.atomValue));
+    }
+
+    struct ByChannel
+    {
+        static int compareElements (const Connection& a, const Connection& b)
+        {
+            return a.destChannel - b.destChannel;
+        }
+    } byChannel;
+
+    graphInputs.clearQuick();
+    graphOutputs.clearQuick();
+
+    for (const auto& c : audioConnections)
+    {
+        if (c.sourceNode < 0)
+            graphInputs.add (c);
+        if (c.destNode < 0)
+            graphOutputs.addSorted (byChannel, c);
+        if (c.sourceNode < 0 || c.destNode < 0)
+            continue;
+
+        auto& module = *nodes.getUnchecked(c.destNode)->module;
+        module.getPortBuffer (module.getChannelConfig().getPort (PortType::Audio, c.destChannel, true))
+            ->referTo (getOutputBuffer (c.sourceNode, c.sourceChannel));
+    }
+
+    for (const auto& c : midiConnections)
+    {
+        auto& dest = *nodes.getUnchecked(c.destNode)->module;
+        dest.getPortBuffer (dest.getMidiPort())->referTo (
+            nodes.getUnchecked(c.sourceNode)->atomOut->getPortData());
+    }
+
+    for (auto* deque : deques)
+        deque->resize (nodes.size());
+
+    return Result::ok();
+}
+
+void ModuleGraph::planBuffers (const Array<int>& order)
+{
+    // node n reads at step 2 * position and, unless it's lv2:inPlaceBroken,
+    // writes at the step after so its outputs may take over its inputs
+    const int endStep = nodes.size() * 2;
+    const uint32 audioSize = (uint32) blockSize * sizeof (float);
+    Array<int> position;
+    position.insertMultiple (0, 0, nodes.size());
+    for (int i = 0; i < order.size(); ++i)
+        position.set (order.getUnchecked (i), i);
+
+    planner.clear();
+    Array<int> producers;
+    Array<Array<int>> readers;
+
+    auto addValue = [&] (int node, uint32 size, int first) -> int
+    {
+        producers.add (node);
+        readers.add (Array<int>());
+        return planner.add (size, first, first);
+    };
+
+    auto addReader = [&] (int value, int node, int step)
+    {
+        planner.use (value, step);
+        if (node >= 0)
+            readers.getReference (value).addIfNotAlreadyThere (node);
+    };
+
+    for (int n = 0; n < nodes.size(); ++n)
+    {
+        auto& node = *nodes.getUnchecked (n);
+        const int readStep  = position.getUnchecked (n) * 2;
+        const int writeStep = node.module->isInPlaceBroken() ? readStep : readStep + 1;
+
+        node.outputValues.clearQuick();
+        for (int c = 0; c < node.module->getChannelConfig().getNumAudioOutputs(); ++c)
+            node.outputValues.add (addValue (n, audioSize, writeStep));
+
+        // atom outputs are reset before their node runs, so never in place
+        node.atomValue = node.atomOut != nullptr
+                       ? addValue (n, node.atomOut->getCapacity(), readStep) : -1;
+    }
+
+    for (const auto& c : audioConnections)
+    {
+        if (c.sourceNode < 0)
+            continue;
+        const int value = nodes.getUnchecked(c.sourceNode)->outputValues.getUnchecked (c.sourceChannel);
+        addReader (value, c.destNode, c.destNode < 0 ? endStep : position.getUnchecked (c.destNode) * 2);
+    }
+
+    for (const auto& c : midiConnections)
+        addReader (nodes.getUnchecked(c.sourceNode)->atomValue, c.destNode, position.getUnchecked (c.destNode) * 2);
+
+    // nodes run in parallel, so a buffer only changes hands once everything
+    // which touched it has certainly run before the next producer starts
+    Array<BigInteger> ancestors;
+    ancestors.insertMultiple (0, BigInteger(), nodes.size());
+    for (const auto n : order)
+    {
+        for (const auto dependent : nodes.getUnchecked(n)->dependents)
+        {
+            auto& bits = ancestors.getReference (dependent);
+            bits |= ancestors.getReference (n);
+            bits.setBit (n);
+        }
+    }
+
+    planner.canShare = [&] (int previous, int next) -> bool
+    {
+        const int producer = producers.getUnchecked (next);
+        const auto& before = ancestors.getReference (producer);
+        const int owner = producers.getUnchecked (previous);
+        if (owner != producer && ! before[owner])
+            return false;
+        for (const auto reader : readers.getReference (previous))
+            if (reader != producer && ! before[reader])
+                return false;
+        return true;
+    };
+
+    planner.plan();
+    planner.canShare = nullptr;
+}
+
+void ModuleGraph::process (AudioSampleBuffer& audio)
+{
+    jassert (audio.getNumSamples() <= blockSize);
+    const int frames      = jmin (audio.getNumSamples(), blockSize);
+    const int numChannels = audio.getNumChannels();
+
+    if (frames <= 0)
+        return;
+
+    for (const auto& c : graphInputs)
+    {
+        auto& module = *nodes.getUnchecked(c.destNode)->module;
+        module.getPortBuffer (module.getChannelConfig().getPort (PortType::Audio, c.destChannel, true))
+            ->referTo (c.sourceChannel < numChannels ? audio.getWritePointer (c.sourceChannel) : silence.getData());
+    }
+
+    if (! roots.isEmpty())
+    {
+        for (auto* node : nodes)
+            node->pending.store (node->numDependencies, std::memory_order_relaxed);
+
+        numFrames = static_cast<uint32> (frames);
+        remaining.store (nodes.size(), std::memory_order_release);
+
+        auto& own = *deques.getUnchecked (0);
+        for (const auto root : roots)
+            own.push (root);
+        for (auto* worker : workers)
+            worker->signal();
+
+        work (0);
+    }
+
+    // graph inputs were read in place, so outputs can only be mixed now
+    int next = 0;
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        bool written = false;
+        for (; next < graphOutputs.size() && graphOutputs.getReference(next).destChannel == channel; ++next)
+        {
+            const auto& c = graphOutputs.getReference (next);
+            const auto* source = getOutputBuffer (c.sourceNode, c.sourceChannel);
+            if (written)
+                FloatVectorOperations::add (audio.getWritePointer (channel), source, frames);
+            else
+                FloatVectorOperations::copy (audio.getWritePointer (channel), source, frames);
+            written = true;
+        }
+
+        if (! written)
+            audio.clear (channel, 0, frames);
+    }
+}
+
+void ModuleGraph::work (int thread)
+{
+    auto& own = *deques.getUnchecked (thread);
+    int node = -1;
+
+    while (remaining.load (std::memory_order_acquire) > 0)
+        if (own.pop (node) || steal (thread, node))
+            runNode (node, thread);
+}
+
+bool ModuleGraph::steal (int thread, int& node)
+{
+    const int numDeques = deques.size();
+    for (int i = 1; i < numDeques; ++i)
+        if (deques.getUnchecked ((thread + i) % numDeques)->steal (node))
+            return true;
+    return false;
+}
+
+void ModuleGraph::runNode (int index, int thread)
+{
+    auto& node = *nodes.getUnchecked (index);
+
+    const auto start = Time::getHighResolutionTicks();
+    node.module->run (numFrames);
+    const auto ticks = Time::getHighResolutionTicks() - start;
+
+    node.lastTicks.store (ticks, std::memory_order_relaxed);
+    if (ticks > node.peakTicks.load (std::memory_order_relaxed))
+        node.peakTicks.store (ticks, std::memory_order_relaxed);
+    node.thread.store (thread, std::memory_order_relaxed);
+
+    auto& own = *deques.getUnchecked (thread);
+    for (const auto dependent : node.dependents)
+        if (nodes.getUnchecked(dependent)->pending.fetch_sub (1, std::memory_order_acq_rel) == 1)
+            own.push (dependent);
+
+    remaining.fetch_sub (1, std::memory_order_release);
+}
+
+ModuleGraph::Timing ModuleGraph::getTiming (int index) const
+{
+    Timing timing;
+    if (auto* node = nodes [index])
+    {
+        timing.lastSeconds = Time::highResolutionTicksToSeconds (node->lastTicks.load (std::memory_order_relaxed));
+        timing.peakSeconds = Time::highResolutionTicksToSeconds (node->peakTicks.load (std::memory_order_relaxed));
+        timing.thread      = node->thread.load (std::memory_order_relaxed);
+    }
+    return timing;
+}
+
+void ModuleGraph::resetTiming()
+{
+    for (auto* node : nodes)
+        node->peakTicks.store (0, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,143 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Runs a DAG of Modules, spreading independent branches over cores.
+
+    Connections share memory like ModuleChain, so a module's input reads the
+    output of the module feeding it directly. Each block, modules become ready
+    as soon as everything feeding them has run. Ready modules go on the deque
+    of the thread which released them, and idle threads steal from the others.
+    The thread calling process() takes part and returns when all have run.
+
+    An input may have only one source. Graph outputs may have any number,
+    which are summed.
+
+    Output buffers come from a BufferPlanner. A buffer is reused once every
+    node touching it is an ancestor of the next node to write it, so nodes
+    which might run at the same time never share.
+ */
+class JLV2_API ModuleGraph final
+{
+public:
+    ModuleGraph();
+    ~ModuleGraph();
+
+    /** Add an instantiated module. The graph takes ownership
+        @returns The node index */
+    int addNode (Module* module);
+
+    /** Returns the number of nodes */
+    inline int getNumNodes() const { return nodes.size(); }
+
+    /** Returns the module for a node */
+    Module* getModule (int node) const;
+
+    /** Feed an audio input of one node with an audio output of another
+        @returns false if the nodes or channels don't exist, or the input
+                 is already connected */
+    bool connect (int sourceNode, int sourceChannel, int destNode, int destChannel);
+
+    /** Feed a node's MIDI input with the notify output of another */
+    bool connectMidi (int sourceNode, int destNode);
+
+    /** Feed a node's audio input with a channel of the buffer given to process() */
+    bool connectInput (int channel, int destNode, int destChannel);
+
+    /** Mix a node's audio output into a channel of the buffer given to process() */
+    bool connectOutput (int sourceNode, int sourceChannel, int channel);
+
+    /** Remove all nodes and connections */
+    void clear();
+
+    /** Set how many threads run nodes, including the one calling process()
+        @note This is NOT realtime safe */
+    void setNumThreads (int numThreads);
+
+    /** Returns the number of threads running nodes */
+    inline int getNumThreads() const { return deques.size(); }
+
+    /** Allocate buffers, connect ports and order the graph
+        @param maxBlockSize The largest block process() will be called with
+        @returns An error if the connections contain a cycle
+        @note This is NOT realtime safe
+     */
+    Result prepare (int maxBlockSize);
+
+    /** Process a block in place through the graph (realtime)
+        Channels not connected to a node output are cleared.
+        @note The block must not be longer than the size given to prepare()
+     */
+    void process (AudioSampleBuffer& audio);
+
+    /** Timing of a node's most recent run */
+    struct Timing
+    {
+        double lastSeconds = 0.0;   ///< time spent in Module::run last block
+        double peakSeconds = 0.0;   ///< longest Module::run since resetTiming()
+        int thread = -1;            ///< which thread ran it, 0 is the caller of process()
+    };
+
+    /** Returns timing for a node (any thread) */
+    Timing getTiming (int node) const;
+
+    /** Reset peak times */
+    void resetTiming();
+
+private:
+    class Worker;
+    struct Node;
+
+    struct Connection
+    {
+        int sourceNode, sourceChannel;
+        int destNode, destChannel;
+    };
+
+    OwnedArray<Node> nodes;
+    Array<Connection> audioConnections;     ///< node or -1 (graph) on either end
+    Array<Connection> midiConnections;
+    Array<Connection> graphInputs;          ///< audio connections from the process() buffer
+    Array<Connection> graphOutputs;         ///< audio connections to it, by channel
+    Array<int> roots;
+
+    OwnedArray<WorkStealingDeque<int>> deques;
+    OwnedArray<Worker> workers;
+    std::atomic<int> remaining { 0 };
+    uint32 numFrames = 0;
+
+    int blockSize = 0;
+    BufferPlanner planner;
+    HeapBlock<float> silence;
+
+    bool isInputConnected (int node, int channel) const;
+    bool isValidChannel (int node, int channel, bool isInput) const;
+    float* getOutputBuffer (int node, int channel);
+    void planBuffers (const Array<int>& order);
+
+    void work (int thread);
+    bool steal (int thread, int& node);
+    void runNode (int node, int thread);
+
+    JUCE_DECLARE_NON_COPYABLE (ModuleGraph)
+};
+
+}
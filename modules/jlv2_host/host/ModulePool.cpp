@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+namespace jlv2 {
+
+ModulePool::ModulePool (World& w)
+    : world (w) { }
+
+ModulePool::~ModulePool()
+{
+    clear();
+}
+
+void ModulePool::clear()
+{
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+        graph.getModule(i)->deactivate();
+    graph.clear();
+    numChannelsPerInstance = numOutputs = 0;
+}
+
+Result ModulePool::create (const String& pluginURI, int numInstances, double sampleRate, int maxBlockSize)
+{
+    clear();
+
+    std::unique_ptr<Module> prototype (world.createModule (pluginURI));
+    if (prototype == nullptr)
+        return Result::fail ("plugin not found: " + pluginURI);
+
+    const auto& channels   = prototype->getChannelConfig();
+    const int numInputs    = channels.getNumAudioInputs();
+    numOutputs             = channels.getNumAudioOutputs();
+    numChannelsPerInstance = jmax (numInputs, numOutputs);
+
+    graph.addNode (prototype.release());
+    for (int i = 1; i < numInstances; ++i)
+        graph.addNode (new Module (world, *graph.getModule (0)));
+
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+    {
+        auto* module = graph.getModule (i);
+        module->setMaxBlockLength (static_cast<uint32> (jmax (1, maxBlockSize)));
+
+        const auto result = module->instantiate (sampleRate);
+        if (result.failed())
+        {
+            clear();
+            return result;
+        }
+
+        module->activate();
+
+        const int offset = i * numChannelsPerInstance;
+        for (int c = 0; c < numInputs; ++c)
+            graph.connectInput (offset + c, i, c);
+        for (int c = 0; c < numOutputs; ++c)
+            graph.connectOutput (i, c, offset + c);
+    }
+
+    return graph.prepare (maxBlockSize);
+}
+
+void ModulePool::process (AudioSampleBuffer& streams, AudioSampleBuffer* mix)
+{
+    graph.process (streams);
+
+    if (mix == nullptr)
+        return;
+
+    const int numFrames = jmin (streams.getNumSamples(), mix->getNumSamples());
+    mix->clear (0, numFrames);
+
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+    {
+        const int offset = i * numChannelsPerInstance;
+        for (int c = 0; c < jmin (numOutputs, mix->getNumChannels()); ++c)
+            if (offset + c < streams.getNumChannels())
+                mix->addFrom (c, 0, streams, offset + c, 0, numFrames);
+    }
+}
+
+}
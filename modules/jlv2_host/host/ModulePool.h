@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Many instances of one plugin, each processing its own stream.
+
+    The first instance reads the plugin's ports from lilv and the rest share
+    that description. Instances run in parallel on a ModuleGraph with no
+    connections between nodes, so idle threads steal whole instances.
+ */
+class JLV2_API ModulePool final
+{
+public:
+    explicit ModulePool (World& world);
+    ~ModulePool();
+
+    /** Create, instantiate and activate instances of a plugin, replacing
+        any existing ones
+        @note This is NOT realtime safe
+     */
+    Result create (const String& pluginURI, int numInstances, double sampleRate, int maxBlockSize);
+
+    /** Delete all instances */
+    void clear();
+
+    /** Returns the number of instances */
+    inline int size() const { return graph.getNumNodes(); }
+
+    /** Returns an instance */
+    inline Module* getModule (int index) const { return graph.getModule (index); }
+
+    /** Returns how many channels of the process() buffer belong to each
+        instance. This is the larger of its audio input and output counts */
+    inline int getNumChannelsPerInstance() const { return numChannelsPerInstance; }
+
+    /** Set how many threads run instances, including the one calling process()
+        @note This is NOT realtime safe */
+    inline void setNumThreads (int numThreads) { graph.setNumThreads (numThreads); }
+
+    /** Returns the number of threads running instances */
+    inline int getNumThreads() const { return graph.getNumThreads(); }
+
+    /** Process every instance in place (realtime)
+        @param streams  Instance N reads and writes channels starting at
+                        N * getNumChannelsPerInstance()
+        @param mix      If not null, receives the sum of all instance outputs
+     */
+    void process (AudioSampleBuffer& streams, AudioSampleBuffer* mix = nullptr);
+
+    /** Returns the timing of an instance's last run (any thread) */
+    inline ModuleGraph::Timing getTiming (int index) const { return graph.getTiming (index); }
+
+    /** Reset peak times */
+    inline void resetTiming() { graph.resetTiming(); }
+
+private:
+    World& world;
+    ModuleGraph graph;
+    int numChannelsPerInstance = 0;
+    int numOutputs = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ModulePool)
+};
+
+}
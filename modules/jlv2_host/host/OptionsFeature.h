@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Advertises bufsz:minBlockLength and bufsz:maxBlockLength to plugins */
+class OptionsFeature :  public LV2Feature
+{
+public:
+    OptionsFeature (uint32 minBlockLengthURID, uint32 maxBlockLengthURID, uint32 intURID,
+                    int minBlockLength = 128, int maxBlockLength = 8192)
+        : minBlockLengthValue (minBlockLength),
+          maxBlockLengthValue (maxBlockLength)
+    {
+        uri = LV2_OPTIONS__options;
+        feat.URI    = uri.toRawUTF8();
+        feat.data   = options;
+
+        minBlockLengthOption = LV2_Options_Option{LV2_OPTIONS_INSTANCE,
+                                0,
+                                minBlockLengthURID,
+                                sizeof(int),
+                                intURID,
+                                &minBlockLengthValue};
+        maxBlockLengthOption = LV2_Options_Option{LV2_OPTIONS_INSTANCE,
+                                0,
+                                maxBlockLengthURID,
+                                sizeof(int),
+                                intURID,
+                                &maxBlockLengthValue};
+        options[0] = minBlockLengthOption;
+        options[1] = maxBlockLengthOption;
+        options[2] = LV2_Options_Option{LV2_OPTIONS_BLANK, 0, 0, 0, 0};                        
+    }
+
+    virtual ~OptionsFeature() { }
+
+    /** Change the advertised block lengths. Plugins only read these when
+        instantiated */
+    void setBlockLengths (int newMinBlockLength, int newMaxBlockLength)
+    {
+        minBlockLengthValue = newMinBlockLength;
+        maxBlockLengthValue = newMaxBlockLength;
+    }
+
+    int getMinBlockLength() const { return minBlockLengthValue; }
+    int getMaxBlockLength() const { return maxBlockLengthValue; }
+
+    LV2_Options_Option minBlockLengthOption, maxBlockLengthOption;
+    LV2_Options_Option options[3];
+    const String& getURI() const { return uri; }
+    const LV2_Feature* getFeature() const { return &feat; }
+
+private:
+    int minBlockLengthValue;
+    int maxBlockLengthValue;
+    String       uri;
+    LV2_Feature  feat;
+};
+
+}
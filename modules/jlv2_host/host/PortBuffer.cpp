@@ -21,29 +21,41 @@ static uint32 portBufferPadSize (uint32 size)
     return (size + 7) & (~7);
 }
 
-PortBuffer::PortBuffer (bool inputPort, uint32 portType, uint32 dataType, uint32 bufferSize)
+PortBuffer::PortBuffer (bool inputPort, uint32 portType, uint32 dataType, uint32 bufferSize, void* externalStorage)
     : type (portType), 
       capacity (std::max (sizeof (float), (size_t) bufferSize)),
       bufferType (dataType),
       input (inputPort)
 {
-    data.reset (new uint8 [capacity]);
+    if (externalStorage != nullptr)
+    {
+        storage = static_cast<uint8*> (externalStorage);
+    }
+    else
+    {
+        data.reset (new uint8 [capacity]());
+        storage = data.get();
+    }
 
     if (type == PortType::Atom)
     {
-        buffer.atom = (LV2_Atom*) data.get();
+        buffer.atom = (LV2_Atom*) storage;
     }
     else if (type == PortType::Event)
     {
-        buffer.event = (LV2_Event_Buffer*) data.get();
+        buffer.event = (LV2_Event_Buffer*) storage;
     }
 	else if (type == PortType::Audio)
     {
-        buffer.audio = (float*) data.get();
+        buffer.audio = (float*) storage;
 	}
     else if (type == PortType::Control)
     {
-        buffer.control = (float*) data.get();
+        buffer.control = (float*) storage;
+    }
+    else if (type == PortType::CV)
+    {
+        buffer.cv = (float*) storage;
     }
     else
     {
@@ -57,9 +69,24 @@ PortBuffer::PortBuffer (bool inputPort, uint32 portType, uint32 dataType, uint32
 PortBuffer::~PortBuffer()
 {
     buffer.atom = nullptr;
+    storage = nullptr;
     data.reset();
 }
 
+void PortBuffer::setStorage (void* newStorage, uint32 newCapacity)
+{
+    jassert (newStorage != nullptr && newCapacity >= sizeof (float));
+    storage  = static_cast<uint8*> (newStorage);
+    capacity = newCapacity;
+    data.reset();
+
+    if (! referenced)
+    {
+        buffer.referred = storage;
+        reset();
+    }
+}
+
 float PortBuffer::getValue() const
 {
     jassert (type == PortType::Control);
@@ -114,7 +141,7 @@ bool PortBuffer::addEvent (int64 frames, uint32 size, uint32 bodyType, const uin
 
 void PortBuffer::clear()
 {
-    if (isAudio() || isControl())
+    if (isAudio() || isControl() || isCV())
     {
 
 	}
@@ -131,15 +158,10 @@ void PortBuffer::clear()
 
 void PortBuffer::reset()
 {
-    if (isAudio())
+    if (isAudio() || isControl() || isCV())
     {
-        buffer.atom->size = capacity - sizeof (LV2_Atom);
+        // plain floats, nothing to set up
 	}
-    else if (isControl())
-    {
-        buffer.atom->size = sizeof (float);
-        buffer.atom->type = bufferType;
-    }
     else if (isSequence())
     {
         buffer.atom->size = input ? sizeof (LV2_Atom_Sequence_Body) 
@@ -156,13 +178,13 @@ void PortBuffer::reset()
         buffer.event->stamp_type  = LV2_EVENT_AUDIO_STAMP;
         buffer.event->event_count = 0;
         buffer.event->size        = 0;
-        buffer.event->data        = data.get() + sizeof (LV2_Event_Buffer);
+        buffer.event->data        = storage + sizeof (LV2_Event_Buffer);
     }
 }
 
 void* PortBuffer::getPortData() const
 { 
-    return referenced ? buffer.referred : data.get();
+    return referenced ? buffer.referred : storage;
 }
 
 }
@@ -20,10 +20,14 @@
 
 namespace jlv2 {
 
-class PortBuffer final
+class JLV2_API PortBuffer final
 {
 public:
-    PortBuffer (bool inputPort, uint32 portType, uint32 dataType, uint32 bufferSize);
+    /** Create a buffer for a port
+        @param storage Memory of at least bufferSize bytes to use, which must
+                       outlive the buffer. If null the buffer allocates its own */
+    PortBuffer (bool inputPort, uint32 portType, uint32 dataType, uint32 bufferSize,
+                void* storage = nullptr);
     ~PortBuffer();
 
     void clear();
@@ -39,10 +43,25 @@ public:
     inline bool isAtom()     const { return type == PortType::Atom; }
 	inline bool isAudio()    const { return type == PortType::Audio; }
 	inline bool isControl()  const { return type == PortType::Control; }
+    inline bool isCV()       const { return type == PortType::CV; }
     inline bool isEvent()    const { return type == PortType::Event; }
 	inline bool isSequence() const { return isAtom(); }
 
-    void referTo (void* location) { buffer.referred = location; referenced = true; }
+    /** Point the port at memory owned elsewhere, or back at its own storage
+        if location is nullptr */
+    void referTo (void* location)
+    {
+        referenced = location != nullptr;
+        buffer.referred = referenced ? location : storage;
+    }
+
+    /** Returns true if the port points at memory owned elsewhere */
+    inline bool isReferenced() const { return referenced; }
+
+    /** Replace the buffer's own storage, which must outlive the buffer.
+        Contents are not copied
+        @note This is NOT realtime safe */
+    void setStorage (void* newStorage, uint32 newCapacity);
 
     float getValue() const;
     void setValue (float value);
@@ -54,6 +73,7 @@ private:
     bool input              = true;
 
     std::unique_ptr<uint8[]> data;
+    uint8* storage = nullptr;
     bool referenced = false;
 
     Atomic<float> value;
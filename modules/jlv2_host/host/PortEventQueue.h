@@ -0,0 +1,223 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** A bounded queue of PortEvents with many writers and one reader.
+
+    The queue is a ring of cache line sized cells. A writer claims all the
+    cells an event needs with one compare and swap, fills them, then
+    publishes the first one. Small events fit in a single cell, larger ones
+    carry on into the cells after it.
+
+    Writers never lock or allocate, but it is lock-free rather than
+    wait-free: a writer preempted between claiming and publishing holds up
+    the reader at that event until it resumes. Writers behind it are not
+    held up.
+ */
+class PortEventQueue final
+{
+public:
+    PortEventQueue (int minCells)   { resize (minCells); }
+    ~PortEventQueue() = default;
+
+    /** Set the number of cells (rounded up to a power of two) and empty the queue
+        @note This is NOT realtime safe, and nothing may use the queue meanwhile */
+    void resize (int minCells)
+    {
+        capacity = (uint32) nextPowerOfTwo (jmax (2, minCells));
+        mask = capacity - 1;
+
+        storage.allocate ((size_t) (capacity + 1) * sizeof (Cell), true);
+        const auto address = reinterpret_cast<pointer_sized_int> (storage.getData());
+        cells = reinterpret_cast<Cell*> ((address + sizeof (Cell) - 1) & ~(pointer_sized_int) (sizeof (Cell) - 1));
+        for (uint32 i = 0; i < capacity; ++i)
+            new (cells + i) Cell (i);
+
+        scratch.allocate ((size_t) capacity * sizeof (Cell::data), true);
+        writePos.store (0, std::memory_order_relaxed);
+        readPos.store (0, std::memory_order_relaxed);
+        highWater.store (0, std::memory_order_relaxed);
+    }
+
+    /** Returns the number of cells */
+    inline int getNumCells() const { return (int) capacity; }
+
+    /** Returns the number of cells an event with size bytes of data takes */
+    static inline uint32 getNumCellsFor (uint32 size)
+    {
+        return size <= inlineSize ? 1 : 2 + (size - inlineSize - 1) / sizeof (Cell::data);
+    }
+
+    /** Queue an event and its data (any thread)
+        @returns false if the queue doesn't have room */
+    inline bool write (const PortEvent& event, const void* data)
+    {
+        const uint32 numCells = getNumCellsFor (event.size);
+        if (numCells > capacity)
+        {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+
+        auto pos = writePos.load (std::memory_order_relaxed);
+        for (;;)
+        {
+            // the reader frees cells in order, so the last one being free
+            // means they all are
+            const uint32 last = pos + numCells - 1;
+            const auto diff = (int32) (cells[last & mask].sequence.load (std::memory_order_acquire) - last);
+
+            if (diff == 0)
+            {
+                if (writePos.compare_exchange_weak (pos, pos + numCells, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                numDropped.fetch_add (1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = writePos.load (std::memory_order_relaxed);
+            }
+        }
+
+        Cell& head = cells[pos & mask];
+        memcpy (head.data, &event, sizeof (PortEvent));
+
+        const auto* src = static_cast<const uint8*> (data);
+        uint32 copied = jmin (event.size, (uint32) inlineSize);
+        memcpy (head.data + sizeof (PortEvent), src, copied);
+
+        for (uint32 i = 1; i < numCells; ++i)
+        {
+            const uint32 chunk = jmin (event.size - copied, (uint32) sizeof (Cell::data));
+            memcpy (cells[(pos + i) & mask].data, src + copied, chunk);
+            copied += chunk;
+        }
+
+        head.sequence.store (pos + 1, std::memory_order_release);
+
+        bytesWritten.fetch_add (numCells * sizeof (Cell), std::memory_order_relaxed);
+        const uint32 waiting = (pos + numCells - readPos.load (std::memory_order_relaxed)) * sizeof (Cell);
+        auto peak = highWater.load (std::memory_order_relaxed);
+        while (waiting > peak && ! highWater.compare_exchange_weak (peak, waiting, std::memory_order_relaxed)) {}
+        return true;
+    }
+
+    /** Call back with each published event in order, then free their cells (reader)
+
+        Stops at the first event still being written, or after a full
+        queue's worth of cells so writers can't keep the reader busy.
+
+        @param callback Called as callback (const PortEvent&, const void* data)
+        @returns The number of events read
+     */
+    template<typename Callback>
+    inline int read (Callback&& callback)
+    {
+        int numEvents = 0;
+        uint32 pos = readPos.load (std::memory_order_relaxed);
+        const uint32 end = pos + capacity;
+
+        while ((int32) (end - pos) > 0)
+        {
+            Cell& head = cells[pos & mask];
+            if (head.sequence.load (std::memory_order_acquire) != pos + 1)
+                break;
+
+            PortEvent event;
+            memcpy (&event, head.data, sizeof (PortEvent));
+            const uint32 numCells = getNumCellsFor (event.size);
+
+            const uint8* data = head.data + sizeof (PortEvent);
+            if (numCells > 1)
+            {
+                // gather the pieces
+                uint32 copied = inlineSize;
+                memcpy (scratch.getData(), data, copied);
+
+                for (uint32 i = 1; i < numCells; ++i)
+                {
+                    const uint32 chunk = jmin (event.size - copied, (uint32) sizeof (Cell::data));
+                    memcpy (scratch.getData() + copied, cells[(pos + i) & mask].data, chunk);
+                    copied += chunk;
+                }
+
+                data = scratch.getData();
+            }
+
+            callback (event, static_cast<const void*> (data));
+
+            for (uint32 i = 0; i < numCells; ++i)
+                cells[(pos + i) & mask].sequence.store (pos + i + capacity, std::memory_order_release);
+            pos += numCells;
+            readPos.store (pos, std::memory_order_relaxed);
+            ++numEvents;
+        }
+
+        return numEvents;
+    }
+
+    /** Count an event which was read but couldn't be used (reader) */
+    inline void countDrop() { numDropped.fetch_add (1, std::memory_order_relaxed); }
+
+    /** Returns the traffic so far, counting whole cells (any thread) */
+    inline QueueStats getStats() const
+    {
+        QueueStats stats;
+        stats.bytesWritten = bytesWritten.load (std::memory_order_relaxed);
+        stats.numDropped   = numDropped.load (std::memory_order_relaxed);
+        stats.highWater    = highWater.load (std::memory_order_relaxed);
+        stats.capacity     = capacity * (uint32) sizeof (Cell);
+        return stats;
+    }
+
+private:
+    struct Cell
+    {
+        explicit Cell (uint32 s) : sequence (s) { }
+        std::atomic<uint32> sequence;
+        uint32 padding = 0;
+        uint8 data [56];
+    };
+
+    static_assert (sizeof (Cell) == 64, "cells should be one cache line");
+    enum : uint32 { inlineSize = sizeof (Cell::data) - sizeof (PortEvent) };
+
+    HeapBlock<uint8> storage;
+    Cell* cells = nullptr;
+    uint32 capacity = 0;
+    uint32 mask = 0;
+    HeapBlock<uint8> scratch;
+
+    alignas (64) std::atomic<uint32> writePos { 0 };
+    std::atomic<uint64> bytesWritten { 0 };
+    std::atomic<uint32> numDropped { 0 };
+    std::atomic<uint32> highWater { 0 };
+
+    alignas (64) std::atomic<uint32> readPos { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (PortEventQueue)
+};
+
+}
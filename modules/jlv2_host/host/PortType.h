@@ -305,10 +305,10 @@ public:
     inline uint32 getInputPort  (const PortType type, const int32 channel) const { return inputs.getPort (type, channel); }
     inline uint32 getOutputPort (const PortType type, const int32 channel) const { return outputs.getPort (type, channel); }
 
-    inline uint32 getAtomPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getAudioPort(channel); }
+    inline uint32 getAtomPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getPort (PortType::Atom, channel); }
     inline uint32 getAudioPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getAudioPort(channel); }
-    inline uint32 getControlPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getAudioPort(channel); }
-    inline uint32 getCVPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getAudioPort(channel); }
+    inline uint32 getControlPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getControlPort (channel); }
+    inline uint32 getCVPort (int32 channel, bool isInput) const { return getChannelMapping(isInput).getPort (PortType::CV, channel); }
 
     inline uint32 getAudioInputPort    (const int32 channel) const { return inputs.getAudioPort (channel); }
     inline uint32 getAudioOutputPort   (const int32 channel) const { return outputs.getAudioPort (channel); }
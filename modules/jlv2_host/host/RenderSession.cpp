@@ -0,0 +1,345 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+namespace jlv2 {
+
+class RenderSession::Internal
+{
+public:
+    Internal()  { formats.registerBasicFormats(); }
+    ~Internal() { }
+
+    World world;
+    AudioFormatManager formats;
+};
+
+/** One job with its own Module. Prepared and destroyed on the thread that
+    owns the session, processed on a pool thread */
+class RenderSession::Task : public ThreadPoolJob
+{
+public:
+    Task (int jobIndex, const Job& j, WaitableEvent& finishedEvent)
+        : ThreadPoolJob ("lv2render"),
+          index (jobIndex), job (j), finished (finishedEvent) { }
+
+    ~Task()
+    {
+        writer.reset();
+        if (module != nullptr)
+            module->deactivate();
+        module.reset();
+    }
+
+    Result prepare (Internal& internal, double rate, int frames, int bitDepth)
+    {
+        blockSize = frames;
+
+        if (job.input != File())
+        {
+            reader.reset (internal.formats.createReaderFor (job.input));
+            if (reader == nullptr)
+                return Result::fail ("could not read " + job.input.getFullPathName());
+            if (rate <= 0.0)
+                rate = reader->sampleRate;
+            else if (rate != reader->sampleRate)
+                return Result::fail ("sample rate of " + job.input.getFullPathName() + " doesn't match the session");
+            length = reader->lengthInSamples;
+        }
+
+        sampleRate = rate > 0.0 ? rate : 48000.0;
+
+        if (job.midi != File())
+        {
+            FileInputStream stream (job.midi);
+            MidiFile file;
+            if (! stream.openedOk() || ! file.readFrom (stream))
+                return Result::fail ("could not read " + job.midi.getFullPathName());
+
+            file.convertTimestampTicksToSeconds();
+            for (int t = 0; t < file.getNumTracks(); ++t)
+                midi.addSequence (*file.getTrack (t), 0.0);
+            midi.sort();
+
+            if (midi.getNumEvents() > 0)
+                length = jmax (length, (int64) (midi.getEndTime() * sampleRate));
+        }
+
+        module.reset (internal.world.createModule (job.pluginURI));
+        if (module == nullptr)
+            return Result::fail ("plugin not found: " + job.pluginURI);
+
+        module->setMaxBlockLength ((uint32) blockSize);
+        module->setSampleAccurateControl (true);
+        const auto res = module->instantiate (sampleRate);
+        if (res.failed())
+            return res;
+
+        if (job.automation != File())
+        {
+            const auto result = loadAutomation();
+            if (result.failed())
+                return result;
+        }
+
+        const int numOutputs = module->getChannelConfig().getNumAudioOutputs();
+        if (numOutputs <= 0)
+            return Result::fail (job.pluginURI + " has no audio outputs");
+
+        auto* format = internal.formats.findFormatForFileExtension (job.output.getFileExtension());
+        if (format == nullptr)
+            format = internal.formats.getDefaultFormat();
+
+        job.output.deleteFile();
+        std::unique_ptr<FileOutputStream> stream (job.output.createOutputStream());
+        if (stream == nullptr)
+            return Result::fail ("could not write " + job.output.getFullPathName());
+
+        writer.reset (format->createWriterFor (stream.get(), sampleRate, (unsigned int) numOutputs,
+                                               bitDepth, {}, 0));
+        if (writer == nullptr)
+            return Result::fail ("could not create a " + format->getFormatName() + " writer");
+        stream.release();
+
+        const auto freeWheel = module->getPortIndexForDesignation (LV2_CORE__freeWheeling);
+        if (freeWheel != LV2UI_INVALID_PORT_INDEX)
+        {
+            const float on = 1.f;
+            module->write (freeWheel, sizeof (float), 0, &on);
+        }
+
+        length += (int64) (job.tailSeconds * sampleRate);
+        module->activate();
+        return Result::ok();
+    }
+
+    Result process()
+    {
+        const auto& channels = module->getChannelConfig();
+        const int numInputs = channels.getNumAudioInputs();
+        AudioSampleBuffer audio (jmax (1, numInputs, channels.getNumAudioOutputs()), blockSize);
+
+        const auto midiPort  = module->getMidiPort();
+        const auto midiEvent = module->map (LV2_MIDI__MidiEvent);
+        int nextEvent = 0, nextPoint = 0;
+
+        for (int64 pos = 0; pos < length;)
+        {
+            if (shouldExit())
+                return Result::fail ("cancelled");
+
+            int numFrames = (int) jmin ((int64) blockSize, length - pos);
+
+            // points the module's queue can't take end the block early and
+            // go into the next one. Those at the start of a block never fail
+            for (; nextPoint < automation.size() && automation.getReference (nextPoint).frame < pos + numFrames; ++nextPoint)
+            {
+                const auto& point = automation.getReference (nextPoint);
+                const auto offset = jmax ((int64) 0, point.frame - pos);
+                if (! module->write (point.port, sizeof (float), 0, &point.value, offset))
+                {
+                    jassert (offset > 0);
+                    numFrames = (int) offset;
+                    break;
+                }
+            }
+
+            const int64 end = pos + numFrames;
+
+            audio.clear();
+            if (reader != nullptr && numInputs > 0 && pos < reader->lengthInSamples)
+                reader->read (&audio, 0, numFrames, pos, true, true);
+
+            if (midiPort != LV2UI_INVALID_PORT_INDEX)
+            {
+                auto* const buffer = module->getPortBuffer (midiPort);
+                buffer->reset();
+
+                for (; nextEvent < midi.getNumEvents(); ++nextEvent)
+                {
+                    const auto& msg = midi.getEventPointer (nextEvent)->message;
+                    const auto frame = (int64) (msg.getTimeStamp() * sampleRate);
+                    if (frame >= end)
+                        break;
+                    if (! msg.isMetaEvent())
+                        buffer->addEvent (jmax ((int64) 0, frame - pos), (uint32) msg.getRawDataSize(),
+                                          midiEvent, msg.getRawData());
+                }
+            }
+
+            module->referAudioReplacing (audio);
+            module->run ((uint32) numFrames);
+
+            if (! writer->writeFromAudioSampleBuffer (audio, 0, numFrames))
+                return Result::fail ("error writing " + job.output.getFullPathName());
+
+            pos += numFrames;
+        }
+
+        writer.reset();
+        return Result::ok();
+    }
+
+    JobStatus runJob() override
+    {
+        result = process();
+        done.store (true);
+        finished.signal();
+        return jobHasFinished;
+    }
+
+    bool isDone() const { return done.load(); }
+
+    const int index;
+    Result result { Result::ok() };
+
+private:
+    const Job job;
+    WaitableEvent& finished;
+    std::atomic<bool> done { false };
+
+    std::unique_ptr<Module> module;
+    std::unique_ptr<AudioFormatReader> reader;
+    std::unique_ptr<AudioFormatWriter> writer;
+
+    double sampleRate = 48000.0;
+    int blockSize = 4096;
+    int64 length = 0;
+
+    struct Point
+    {
+        int64  frame;
+        uint32 port;
+        float  value;
+    };
+
+    MidiMessageSequence midi;
+    Array<Point> automation;
+
+    Result loadAutomation()
+    {
+        StringArray lines;
+        lines.addLines (job.automation.loadFileAsString());
+
+        for (int i = 0; i < lines.size(); ++i)
+        {
+            const auto line = lines[i].upToFirstOccurrenceOf ("#", false, false).trim();
+            if (line.isEmpty())
+                continue;
+
+            StringArray tokens;
+            tokens.addTokens (line, " \t", "");
+            tokens.removeEmptyStrings();
+
+            const auto port = tokens.size() == 3 ? module->getPortIndex (tokens[1])
+                                                 : (uint32) LV2UI_INVALID_PORT_INDEX;
+            if (port == LV2UI_INVALID_PORT_INDEX || module->getPortType (port) != PortType::Control
+                || ! module->isPortInput (port))
+                return Result::fail (job.automation.getFileName() + ":" + String (i + 1) + ": invalid automation point");
+
+            const Point point { (int64) (tokens[0].getDoubleValue() * sampleRate), port, tokens[2].getFloatValue() };
+            int insertAt = automation.size();
+            while (insertAt > 0 && automation.getReference (insertAt - 1).frame > point.frame)
+                --insertAt;
+            automation.insert (insertAt, point);
+            length = jmax (length, point.frame);
+        }
+
+        return Result::ok();
+    }
+};
+
+//=============================================================================
+RenderSession::RenderSession()
+{
+    internal.reset (new Internal());
+}
+
+RenderSession::~RenderSession()
+{
+    internal.reset();
+}
+
+Result RenderSession::render (const Job& job)
+{
+    WaitableEvent finished;
+    Task task (0, job, finished);
+    const auto res = task.prepare (*internal, sampleRate, blockSize, bitDepth);
+    return res.wasOk() ? task.process() : res;
+}
+
+Result RenderSession::render (const Array<Job>& jobs, int numThreads, Array<Result>* results)
+{
+    numThreads = jmax (1, numThreads);
+    auto failure = Result::ok();
+
+    if (results != nullptr)
+    {
+        results->clearQuick();
+        results->insertMultiple (0, Result::ok(), jobs.size());
+    }
+
+    auto finish = [&] (int index, const Result& result)
+    {
+        if (results != nullptr)
+            results->set (index, result);
+        if (result.failed() && failure.wasOk())
+            failure = result;
+    };
+
+    ThreadPool pool (numThreads);
+    WaitableEvent finished;
+    OwnedArray<Task> running;
+    int next = 0;
+
+    // plugins are created and destroyed here, only processing is parallel
+    while (next < jobs.size() || running.size() > 0)
+    {
+        for (int i = running.size(); --i >= 0;)
+        {
+            auto* const task = running.getUnchecked (i);
+            if (task->isDone() && pool.waitForJobToFinish (task, -1))
+            {
+                finish (task->index, task->result);
+                running.remove (i);
+            }
+        }
+
+        if (next < jobs.size() && running.size() < numThreads)
+        {
+            std::unique_ptr<Task> task (new Task (next, jobs.getReference (next), finished));
+            ++next;
+
+            const auto res = task->prepare (*internal, sampleRate, blockSize, bitDepth);
+            if (res.failed())
+            {
+                finish (task->index, res);
+                continue;
+            }
+
+            pool.addJob (task.get(), false);
+            running.add (task.release());
+            continue;
+        }
+
+        finished.wait (100);
+    }
+
+    return failure;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Renders files through LV2 plugins offline, as fast as the CPU allows.
+
+    No audio device is involved. Plugins are run with their lv2:freeWheeling
+    port (if any) switched on, and results are written with an
+    AudioFormatWriter chosen by the output file's extension.
+
+    Automation files are plain text, one point per line:
+    @code
+    # seconds   port-symbol   value
+    0.0         gain          -6.0
+    1.5         gain          0.0
+    @endcode
+ */
+class JLV2_API RenderSession final
+{
+public:
+    /** A single file to render */
+    struct Job
+    {
+        String pluginURI;           ///< The plugin to render with
+        File input;                 ///< Audio to process (optional)
+        File midi;                  ///< Standard MIDI file to play (optional)
+        File automation;            ///< Control automation (optional)
+        File output;                ///< Where to write the result
+        double tailSeconds = 0.0;   ///< Extra time to render after the input ends
+    };
+
+    /** Creates a session with its own LV2 world */
+    RenderSession();
+    ~RenderSession();
+
+    /** Sample rate to render at. Zero (the default) uses the input file's
+        rate, or 48kHz when there is no input */
+    void setSampleRate (double newSampleRate)   { sampleRate = newSampleRate; }
+
+    /** Number of frames processed per Module::run */
+    void setBlockSize (int newBlockSize)        { blockSize = jmax (1, newBlockSize); }
+
+    /** Bits per sample of the written files */
+    void setBitDepth (int newBitDepth)          { bitDepth = newBitDepth; }
+
+    /** Render a single job on the calling thread */
+    Result render (const Job& job);
+
+    /** Render several jobs in parallel, with one plugin instance per job
+        @param jobs         The jobs to render
+        @param numThreads   How many jobs to run at once
+        @param results      If not null, filled with the result of each job
+        @returns The first failure, or ok if every job succeeded
+     */
+    Result render (const Array<Job>& jobs, int numThreads, Array<Result>* results = nullptr);
+
+private:
+    class Task;
+    class Internal;
+    std::unique_ptr<Internal> internal;
+
+    double sampleRate = 0.0;
+    int blockSize = 4096;
+    int bitDepth = 24;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderSession)
+};
+
+}
@@ -19,34 +19,31 @@
 namespace jlv2 {
 
 RingBuffer::RingBuffer (int32 capacity)
-    : fifo (1), buffer (nullptr)
 {
     setCapacity (capacity);
 }
 
 RingBuffer::~RingBuffer()
 {
-    fifo.reset();
-    fifo.setTotalSize (1);
-    buffer = nullptr;
     block.free();
 }
 
 void RingBuffer::setCapacity (int32 newCapacity)
 {
-    newCapacity = nextPowerOfTwo (newCapacity);
+    newCapacity = nextPowerOfTwo (jmax ((int32) recordAlign * 2, newCapacity));
 
-    if (fifo.getTotalSize() != newCapacity)
+    if ((int32) capacity != newCapacity)
     {
-        HeapBlock<uint8> newBlock;
-        newBlock.allocate (newCapacity, true);
-        {
-            block.swapWith (newBlock);
-            buffer = block.getData();
-            fifo.setTotalSize (newCapacity);
-        }
+        block.allocate ((size_t) newCapacity, true);
+        capacity = (uint32) newCapacity;
+        mask     = capacity - 1;
     }
 
-    fifo.reset();
+    readPos.store (0, std::memory_order_relaxed);
+    writePos.store (0, std::memory_order_relaxed);
+    cachedRead = 0;
+    pendingRecord = 0;
+    highWater.store (0, std::memory_order_relaxed);
 }
+
 }
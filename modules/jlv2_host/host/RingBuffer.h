@@ -18,23 +18,304 @@
 
 namespace jlv2 {
 
+/** A snapshot of the traffic through a queue */
+struct QueueStats
+{
+    uint64 bytesWritten = 0;    ///< bytes queued, including any framing
+    uint32 numDropped   = 0;    ///< messages refused for lack of room
+    uint32 highWater    = 0;    ///< most bytes ever waiting at once
+    uint32 capacity     = 0;    ///< bytes the queue can hold
+
+    /** Returns the high water mark as a fraction of the capacity */
+    inline double getPeakFill() const { return capacity > 0 ? (double) highWater / (double) capacity : 0.0; }
+
+    /** Add another queue's traffic. The high water mark becomes that of the
+        fullest queue, relative to its own capacity */
+    inline QueueStats& operator+= (const QueueStats& other)
+    {
+        if (other.getPeakFill() > getPeakFill())
+        {
+            highWater = other.highWater;
+            capacity  = other.capacity;
+        }
+
+        bytesWritten += other.bytesWritten;
+        numDropped   += other.numDropped;
+        return *this;
+    }
+};
+
+/** A single producer, single consumer byte ring.
+
+    The read and write positions live on separate cache lines. The writer
+    keeps its last look at the read position, so it only touches the reader's
+    line when the ring seems full. It also counts the bytes written, the
+    writes refused for lack of room and the most bytes ever waiting, which
+    any thread may read with getStats().
+
+    Besides copying reads and writes, space can be reserved and committed in
+    place, and readable data can be peeked at and released in place.
+
+    Framed records are written with beginRecord()/endRecord() or
+    writeRecord() and read with readRecords(). Don't mix records and raw
+    bytes on the same ring.
+ */
 class RingBuffer
 {
 public:
     RingBuffer (int32 capacity);
     ~RingBuffer();
 
+    /** Resize the buffer (rounded up to a power of two) and empty it
+        @note This is NOT realtime safe, and nothing may use the ring meanwhile */
     void setCapacity (int32 newCapacity);
-    inline size_t size() const { return (size_t) fifo.getTotalSize(); }
+    inline size_t size() const { return (size_t) capacity; }
+
+    //=========================================================================
+    /** A contiguous part of the ring */
+    struct Span
+    {
+        uint8* data;
+        uint32 size;
+    };
+
+    /** A range of the ring, in two parts when it wraps around the end */
+    struct Spans
+    {
+        Span first  { nullptr, 0 };
+        Span second { nullptr, 0 };
+
+        /** Total bytes in both parts */
+        inline uint32 size() const { return first.size + second.size; }
+
+        /** Returns a pointer to a range if it doesn't wrap, otherwise nullptr */
+        inline uint8* getContiguous (uint32 offset, uint32 bytes) const
+        {
+            if (offset + bytes <= first.size)
+                return first.data + offset;
+            if (offset >= first.size && offset - first.size + bytes <= second.size)
+                return second.data + (offset - first.size);
+            return nullptr;
+        }
+
+        /** Copy out of the range, starting at offset */
+        inline void read (void* dest, uint32 offset, uint32 bytes) const
+        {
+            jassert (offset + bytes <= size());
+            const uint32 head = offset < first.size ? jmin (bytes, first.size - offset) : 0;
+            if (head > 0)
+                memcpy (dest, first.data + offset, head);
+            if (bytes > head)
+                memcpy (static_cast<uint8*> (dest) + head, second.data + (offset + head - first.size), bytes - head);
+        }
+
+        /** Copy into the range, starting at offset */
+        inline void write (const void* src, uint32 offset, uint32 bytes) const
+        {
+            jassert (offset + bytes <= size());
+            const uint32 head = offset < first.size ? jmin (bytes, first.size - offset) : 0;
+            if (head > 0)
+                memcpy (first.data + offset, src, head);
+            if (bytes > head)
+                memcpy (second.data + (offset + head - first.size), static_cast<const uint8*> (src) + head, bytes - head);
+        }
+    };
+
+    //=========================================================================
+    /** Returns the number of bytes ready to read (reader) */
+    inline uint32 getReadSpace() const
+    {
+        return writePos.load (std::memory_order_acquire) - readPos.load (std::memory_order_relaxed);
+    }
+
+    /** Returns the number of bytes which can be written (writer) */
+    inline uint32 getWriteSpace() const
+    {
+        return capacity - (writePos.load (std::memory_order_relaxed) - readPos.load (std::memory_order_acquire));
+    }
+
+    inline bool canRead  (uint32 bytes) const { return bytes <= getReadSpace() && bytes != 0; }
+    inline bool canWrite (uint32 bytes) const { return bytes <= getWriteSpace() && bytes != 0; }
 
-    inline bool canRead  (uint32 bytes) const { return bytes <= (uint32) fifo.getNumReady() && bytes != 0; }
-    inline uint32 getReadSpace() const { return fifo.getNumReady(); }
+    /** Reserve space to write in place (writer)
+        @returns Spans covering exactly the requested bytes, or empty spans if
+                 there isn't enough room. Nothing is visible to the reader
+                 until commit() */
+    inline Spans reserve (uint32 bytes)
+    {
+        Spans spans;
+        const auto w = writePos.load (std::memory_order_relaxed);
+        if (bytes == 0 || capacity - (w - cachedRead) < bytes)
+        {
+            cachedRead = readPos.load (std::memory_order_acquire);
+            if (bytes == 0 || capacity - (w - cachedRead) < bytes)
+            {
+                countDrop();
+                return spans;
+            }
+        }
+
+        return makeSpans (w, bytes);
+    }
 
-    inline bool canWrite (uint32 bytes) const { return bytes <= (uint32) fifo.getFreeSpace() && bytes != 0; }
-    inline uint32 getWriteSpace() const { return (uint32) fifo.getFreeSpace(); }
+    /** Publish bytes written into reserved space (writer) */
+    inline void commit (uint32 bytes)
+    {
+        const auto w = writePos.load (std::memory_order_relaxed) + bytes;
+        writePos.store (w, std::memory_order_release);
+
+        // only the writer changes the counters
+        bytesWritten.store (bytesWritten.load (std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        const uint32 waiting = w - readPos.load (std::memory_order_relaxed);
+        if (waiting > highWater.load (std::memory_order_relaxed))
+            highWater.store (waiting, std::memory_order_relaxed);
+    }
 
-    inline uint32
-    peak (void* dest, uint32 size)
+    /** Returns the traffic so far (any thread) */
+    inline QueueStats getStats() const
+    {
+        QueueStats stats;
+        stats.bytesWritten = bytesWritten.load (std::memory_order_relaxed);
+        stats.numDropped   = numDropped.load (std::memory_order_relaxed);
+        stats.highWater    = highWater.load (std::memory_order_relaxed);
+        stats.capacity     = capacity;
+        return stats;
+    }
+
+    /** Returns spans covering everything ready to read, in place (reader) */
+    inline Spans peekSpans()
+    {
+        const auto r = readPos.load (std::memory_order_relaxed);
+        return makeSpans (r, writePos.load (std::memory_order_acquire) - r);
+    }
+
+    /** Give bytes at the front back to the writer (reader) */
+    inline void release (uint32 bytes)
+    {
+        jassert (bytes <= getReadSpace());
+        readPos.store (readPos.load (std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    //=========================================================================
+    /** Returns the space a record takes in the ring, including its header */
+    static inline uint32 getRecordSpace (uint32 size)
+    {
+        return (recordHeaderSize + size + recordAlign - 1) & ~(recordAlign - 1);
+    }
+
+    /** Returns the smallest capacity for which a record of size bytes
+        always fits into the empty ring, see beginRecord() */
+    static inline uint32 getCapacityForRecord (uint32 size)
+    {
+        return 2 * getRecordSpace (size);
+    }
+
+    /** Start writing a record in place (writer)
+
+        Records never wrap. If one doesn't fit before the end of the ring, the
+        rest of the ring is skipped. The record and any skip are published
+        together by endRecord(), so readers only ever see whole records.
+
+        Skipping means a record can need its own space plus up to as much
+        again, so records may take at most half the capacity (including
+        their header). Larger ones are always refused.
+
+        @returns Contiguous, 8 byte aligned space for size bytes, or nullptr
+                 if there isn't room */
+    inline uint8* beginRecord (uint32 size)
+    {
+        const uint32 space = getRecordSpace (size);
+        const auto w = writePos.load (std::memory_order_relaxed);
+        const uint32 offset = w & mask;
+        const uint32 tail = capacity - offset;
+        const uint32 needed = space <= tail ? space : tail + space;
+
+        jassert (space <= capacity / 2); // size the ring with getCapacityForRecord()
+        if (space > capacity / 2 || size > space)
+        {
+            countDrop();
+            return nullptr;
+        }
+
+        if (capacity - (w - cachedRead) < needed)
+        {
+            cachedRead = readPos.load (std::memory_order_acquire);
+            if (capacity - (w - cachedRead) < needed)
+            {
+                countDrop();
+                return nullptr;
+            }
+        }
+
+        uint8* record = block.getData() + offset;
+        if (space > tail)
+        {
+            writeLength (record, skipMarker);
+            record = block.getData();
+        }
+
+        writeLength (record, size);
+        pendingRecord = needed;
+        return record + recordHeaderSize;
+    }
+
+    /** Publish the record started with beginRecord() (writer) */
+    inline void endRecord()
+    {
+        jassert (pendingRecord > 0);
+        commit (pendingRecord);
+        pendingRecord = 0;
+    }
+
+    /** Copy a record made of a header and a body (writer)
+        @returns false if there isn't room for both */
+    inline bool writeRecord (const void* header, uint32 headerSize,
+                             const void* body = nullptr, uint32 bodySize = 0)
+    {
+        auto* const record = beginRecord (headerSize + bodySize);
+        if (record == nullptr)
+            return false;
+
+        memcpy (record, header, headerSize);
+        if (bodySize > 0)
+            memcpy (record + headerSize, body, bodySize);
+        endRecord();
+        return true;
+    }
+
+    /** Call back with every complete record, in place, then release them (reader)
+        @param callback Called as callback (const uint8* data, uint32 size)
+        @returns The number of records read */
+    template<typename Callback>
+    inline int readRecords (Callback&& callback)
+    {
+        const auto w = writePos.load (std::memory_order_acquire);
+        auto r = readPos.load (std::memory_order_relaxed);
+        int numRecords = 0;
+
+        while (r != w)
+        {
+            const uint32 offset = r & mask;
+            const uint8* const record = block.getData() + offset;
+            const uint32 size = readLength (record);
+
+            if (size == skipMarker)
+            {
+                r += capacity - offset;
+                continue;
+            }
+
+            callback (record + recordHeaderSize, size);
+            r += getRecordSpace (size);
+            ++numRecords;
+        }
+
+        readPos.store (r, std::memory_order_release);
+        return numRecords;
+    }
+
+    //=========================================================================
+    inline uint32 peak (void* dest, uint32 size)
     {
         return read (dest, size, false);
     }
@@ -42,27 +323,20 @@ public:
     inline void advance (uint32 bytes, bool write)
     {
         if (write)
-            fifo.finishedWrite (static_cast<int> (bytes));
+            commit (bytes);
         else
-            fifo.finishedRead (static_cast<int> (bytes));
+            release (bytes);
     }
 
-    inline uint32
-    read (void* dest, uint32 size, bool advance = true)
+    /** Copy out up to size bytes (reader) */
+    inline uint32 read (void* dest, uint32 size, bool advance = true)
     {
-        buffer = block.getData();
-        fifo.prepareToRead (size, vec1.index, vec1.size, vec2.index, vec2.size);
-
-        if (vec1.size > 0)
-            memcpy (dest, buffer + vec1.index, vec1.size);
-
-        if (vec2.size > 0)
-            memcpy ((uint8*) dest + vec1.size, buffer + vec2.index, vec2.size);
-
+        const auto spans = peekSpans();
+        size = jmin (size, spans.size());
+        spans.read (dest, 0, size);
         if (advance)
-            fifo.finishedRead (vec1.size + vec2.size);
-
-        return vec1.size + vec2.size;
+            release (size);
+        return size;
     }
 
     template <typename T>
@@ -75,20 +349,19 @@ public:
         jassertfalse;
     }
 
-    inline uint32
-    write (const void* src, uint32 bytes)
+    /** Copy in up to bytes bytes (writer) */
+    inline uint32 write (const void* src, uint32 bytes)
     {
-        buffer = block.getData();
-        fifo.prepareToWrite (bytes, vec1.index, vec1.size, vec2.index, vec2.size);
-
-        if (vec1.size > 0)
-            memcpy (buffer + vec1.index, src, vec1.size);
-
-        if (vec2.size > 0)
-            memcpy (buffer + vec2.index, (uint8*)src + vec1.size, vec2.size);
+        if (bytes > getWriteSpace())
+        {
+            countDrop();
+            bytes = getWriteSpace();
+        }
 
-        fifo.finishedWrite (vec1.size + vec2.size);
-        return vec1.size + vec2.size;
+        const auto spans = makeSpans (writePos.load (std::memory_order_relaxed), bytes);
+        spans.write (src, 0, bytes);
+        commit (bytes);
+        return bytes;
     }
 
     template <typename T>
@@ -103,16 +376,45 @@ public:
     };
 
 private:
-    struct Vec
-    {
-        int32 size;
-        int32 index;
+    enum : uint32 {
+        recordHeaderSize = 8,
+        recordAlign      = 8,
+        skipMarker       = 0xffffffff
     };
 
-    Vec vec1, vec2;
-    AbstractFifo fifo;
     HeapBlock<uint8> block;
-    uint8* buffer;
+    uint32 capacity = 0;
+    uint32 mask = 0;
+
+    // reader side
+    alignas (64) std::atomic<uint32> readPos { 0 };
+
+    // writer side, with its last look at the read position and its counters
+    alignas (64) std::atomic<uint32> writePos { 0 };
+    uint32 cachedRead = 0;
+    uint32 pendingRecord = 0;
+    std::atomic<uint32> numDropped { 0 };
+    std::atomic<uint32> highWater { 0 };
+    std::atomic<uint64> bytesWritten { 0 };
+
+    inline void countDrop()
+    {
+        numDropped.store (numDropped.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static inline void writeLength (uint8* record, uint32 size)     { memcpy (record, &size, sizeof (size)); }
+    static inline uint32 readLength (const uint8* record)           { uint32 size; memcpy (&size, record, sizeof (size)); return size; }
+
+    inline Spans makeSpans (uint32 position, uint32 bytes) const
+    {
+        Spans spans;
+        const uint32 start = position & mask;
+        spans.first  = { block.getData() + start, jmin (bytes, capacity - start) };
+        spans.second = { block.getData(), bytes - spans.first.size };
+        return spans;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (RingBuffer)
 };
 
 }
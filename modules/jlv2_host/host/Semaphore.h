@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** A counting semaphore which any number of threads may wait on.
+
+    Uses the platform's own semaphore: GCD on macOS, a kernel semaphore on
+    Windows and POSIX semaphores elsewhere. Each post() wakes at most one
+    waiter and none are ever lost. Posting doesn't take a user space lock,
+    so it's fit for a realtime thread, though on Windows it is a system call.
+ */
+class Semaphore final
+{
+public:
+    Semaphore()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        sem = dispatch_semaphore_create (0);
+       #elif JUCE_WINDOWS
+        sem = CreateSemaphore (nullptr, 0, LONG_MAX, nullptr);
+       #else
+        sem_init (&sem, 0, 0);
+       #endif
+    }
+
+    ~Semaphore()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        dispatch_release (sem);
+       #elif JUCE_WINDOWS
+        CloseHandle (sem);
+       #else
+        sem_destroy (&sem);
+       #endif
+    }
+
+    /** Add one to the count, waking one waiter if there are any (realtime) */
+    inline void post()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_signal (sem);
+       #elif JUCE_WINDOWS
+        ReleaseSemaphore (sem, 1, nullptr);
+       #else
+        sem_post (&sem);
+       #endif
+    }
+
+    /** Wait until the count is above zero, then take one from it */
+    inline void wait()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_wait (sem, DISPATCH_TIME_FOREVER);
+       #elif JUCE_WINDOWS
+        WaitForSingleObject (sem, INFINITE);
+       #else
+        while (sem_wait (&sem) != 0 && errno == EINTR) {}
+       #endif
+    }
+
+    /** Take one from the count if it's above zero, without waiting
+        @returns true if it was */
+    inline bool tryWait()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        return dispatch_semaphore_wait (sem, DISPATCH_TIME_NOW) == 0;
+       #elif JUCE_WINDOWS
+        return WaitForSingleObject (sem, 0) == WAIT_OBJECT_0;
+       #else
+        return sem_trywait (&sem) == 0;
+       #endif
+    }
+
+private:
+   #if JUCE_MAC || JUCE_IOS
+    dispatch_semaphore_t sem;
+   #elif JUCE_WINDOWS
+    HANDLE sem;
+   #else
+    sem_t sem;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (Semaphore)
+};
+
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** Hands fixed size snapshots from one thread to another.
+
+    The writer fills the back buffer and publishes it, the reader picks up
+    the newest published buffer. Neither side ever waits on the other or
+    allocates; a snapshot the reader didn't get to in time is simply
+    replaced by a newer one.
+ */
+template<typename ElementType>
+class TripleBuffer final
+{
+public:
+    TripleBuffer() = default;
+    ~TripleBuffer() = default;
+
+    /** Resize each of the three buffers. Contents are zeroed
+        @note This is NOT realtime safe */
+    void resize (int newNumElements)
+    {
+        numElements = jmax (0, newNumElements);
+        storage.calloc ((size_t) jmax (1, numElements * 3));
+        back   = 0;
+        front  = 1;
+        middle.store (2, std::memory_order_relaxed);
+    }
+
+    /** Returns the number of elements in a snapshot */
+    inline int size() const { return numElements; }
+
+    /** Returns the buffer to fill with the next snapshot (writer) */
+    inline ElementType* getWriteBuffer() { return storage + (back * numElements); }
+
+    /** Publish the write buffer as the newest snapshot (writer) */
+    inline void publish()
+    {
+        back = middle.exchange (back | freshFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /** Acquire the newest snapshot if one was published since the last
+        call. Returns true if the read buffer changed (reader) */
+    inline bool update()
+    {
+        if ((middle.load (std::memory_order_relaxed) & freshFlag) == 0)
+            return false;
+        front = middle.exchange (front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    /** Returns the most recently acquired snapshot (reader) */
+    inline const ElementType* getReadBuffer() const { return storage + (front * numElements); }
+
+private:
+    enum { indexMask = 3, freshFlag = 4 };
+
+    HeapBlock<ElementType> storage;
+    int numElements = 0;
+    int back = 0, front = 1;
+    std::atomic<int> middle { 2 };
+
+    JUCE_DECLARE_NON_COPYABLE (TripleBuffer)
+};
+
+}
@@ -0,0 +1,108 @@
+/*
+    Copyright (c) 2014-2019  Michael Fisher <mfisher@kushview.net>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+namespace jlv2 {
+
+/** A fixed capacity Chase-Lev work stealing deque.
+
+    The owning thread pushes and pops at the bottom, any other thread may
+    steal from the top. Nothing blocks or allocates after resize(). The
+    capacity must cover the most items ever queued at once, there is no
+    growing.
+ */
+template<typename ElementType>
+class WorkStealingDeque final
+{
+public:
+    WorkStealingDeque() = default;
+    ~WorkStealingDeque() = default;
+
+    /** Set the capacity (rounded up to a power of two) and empty the deque
+        @note This is NOT realtime safe, and nothing may use the deque meanwhile */
+    void resize (int minCapacity)
+    {
+        const int capacity = nextPowerOfTwo (jmax (2, minCapacity));
+        items.allocate ((size_t) capacity, true);
+        mask = capacity - 1;
+        top.store (0, std::memory_order_relaxed);
+        bottom.store (0, std::memory_order_relaxed);
+    }
+
+    /** Add an item at the bottom (owner only) */
+    inline void push (ElementType item)
+    {
+        const auto b = bottom.load (std::memory_order_relaxed);
+        jassert (b - top.load (std::memory_order_relaxed) <= mask);
+        items[b & mask].store (item, std::memory_order_relaxed);
+        bottom.store (b + 1, std::memory_order_release);
+    }
+
+    /** Take the most recently pushed item (owner only) */
+    inline bool pop (ElementType& item)
+    {
+        const auto b = bottom.load (std::memory_order_relaxed) - 1;
+        bottom.store (b, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        auto t = top.load (std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            bottom.store (b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = items[b & mask].load (std::memory_order_relaxed);
+        if (t == b)
+        {
+            // last item, race any thieves for it
+            const bool won = top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst,
+                                                          std::memory_order_relaxed);
+            bottom.store (b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    /** Take the oldest item (any thread) */
+    inline bool steal (ElementType& item)
+    {
+        auto t = top.load (std::memory_order_acquire);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        const auto b = bottom.load (std::memory_order_acquire);
+
+        if (t >= b)
+            return false;
+
+        item = items[t & mask].load (std::memory_order_relaxed);
+        return top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+
+private:
+    HeapBlock<std::atomic<ElementType>> items;
+    int64 mask = 0;
+    alignas (64) std::atomic<int64> top { 0 };
+    alignas (64) std::atomic<int64> bottom { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (WorkStealingDeque)
+};
+
+}
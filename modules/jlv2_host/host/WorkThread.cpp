@@ -26,159 +26,274 @@
  #define WORKER_LOG(x)
 #endif
 
+#ifndef JLV2_WORKER_POOL_MAX_THREADS
+ #define JLV2_WORKER_POOL_MAX_THREADS   16
+#endif
+
+#ifndef JLV2_WORKER_POOL_MAX_WORKERS
+ #define JLV2_WORKER_POOL_MAX_WORKERS   1024
+#endif
+
 namespace jlv2 {
 
-WorkThread::WorkThread (const String& name, uint32 bufsize, int32 priority)
-    : Thread (name)
+class WorkerPool::WorkThread : public Thread
 {
-    nextWorkId = 0;
-    bufferSize = (uint32) nextPowerOfTwo (bufsize);
-    requests   = new RingBuffer (bufferSize);
-    startThread (priority);
+public:
+    WorkThread (WorkerPool& p, int i)
+        : Thread ("lv2_worker_" + String (i + 1)),
+          pool (p), index (i) { }
+
+    void run() override { pool.run (*this, index); }
+
+private:
+    WorkerPool& pool;
+    const int index;
+};
+
+WorkerPool::WorkerPool (int numThreads, int32 threadPriority)
+    : priority (threadPriority)
+{
+    static_assert (JLV2_WORKER_POOL_MAX_WORKERS <= slotMask + 1, "too many workers for the id's slot bits");
+
+    // every queue a thread might ever use exists up front, so realtime
+    // threads never see them change. A worker is queued at most once, so
+    // each holds them all
+    for (int i = 0; i < JLV2_WORKER_POOL_MAX_THREADS; ++i)
+        queues.add (new MPMCQueue<uint32> (JLV2_WORKER_POOL_MAX_WORKERS));
+
+    slots.reset (new Slot [JLV2_WORKER_POOL_MAX_WORKERS]);
+    for (int i = JLV2_WORKER_POOL_MAX_WORKERS; --i >= 0;)
+        freeSlots.add (i);
+
+    setNumThreads (numThreads);
 }
 
-WorkThread::~WorkThread()
+WorkerPool::~WorkerPool()
 {
-    doExit = true;
-    signalThreadShouldExit();
-    notify();
-    waitForThreadToExit (100);
-    requests = nullptr;
+    jassert (freeSlots.size() == JLV2_WORKER_POOL_MAX_WORKERS); // delete workers before their pool
+
+    for (auto* thread : threads)
+        thread->signalThreadShouldExit();
+    for (auto* thread : threads)
+        while (! thread->waitForThreadToExit (5))
+            pending.post();
+
+    threads.clear();
 }
 
-WorkerBase* WorkThread::getWorker (uint32 workerId) const
+void WorkerPool::setNumThreads (int numThreads)
 {
-    if (workerId == 0)
-        return nullptr;
+    numThreads = jlimit (1, JLV2_WORKER_POOL_MAX_THREADS, numThreads);
 
-    for (int i = 0; i < workers.size(); ++i)
-        if (workers.getUnchecked(i)->workId == workerId)
-            return workers.getUnchecked (i);
+    // new work only goes to threads which are running and will stay so
+    if (threads.size() > 0)
+        numActive.store (jmin (numThreads, threads.size()));
 
-    return nullptr;
+    while (threads.size() > numThreads)
+    {
+        auto* const thread = threads.getLast();
+        thread->signalThreadShouldExit();
+        while (! thread->waitForThreadToExit (5))
+            pending.post();
+        threads.removeLast();
+    }
+
+    while (threads.size() < numThreads)
+    {
+        threads.add (new WorkThread (*this, threads.size()));
+        threads.getLast()->startThread (priority);
+    }
+
+    numQueues.store (jmax (numQueues.load(), numThreads));
+    numActive.store (numThreads);
+
+    // wake everyone to pick up anything the stopped threads left queued
+    for (int i = 0; i < numThreads; ++i)
+        pending.post();
 }
 
-void WorkThread::addWorker (WorkerBase* worker)
+void WorkerPool::setBlocks (uint32 blockSize, int numBlocks)
 {
-    worker->workId = ++nextWorkId;
-    WORKER_LOG (getThreadName() + " registering worker: " + String (worker->workId));
-    workers.addIfNotAlreadyThere (worker);
+    const ScopedLock sl (registrationLock);
+    jassert (freeSlots.size() == JLV2_WORKER_POOL_MAX_WORKERS); // workers may be using the blocks
+    blocks.resize (blockSize, numBlocks);
 }
 
-void WorkThread::removeWorker (WorkerBase* worker)
+QueueStats WorkerPool::getStats() const
 {
-    WORKER_LOG (getThreadName() + " removing worker: " + String (worker->workId));
-    workers.removeFirstMatchingValue (worker);
-    worker->workId = 0;
+    QueueStats stats;
+    const ScopedLock sl (registrationLock);
+    for (int i = 0; i < JLV2_WORKER_POOL_MAX_WORKERS; ++i)
+        if (auto* const worker = slots[i].worker.load())
+            stats += worker->getRequestStats();
+    return stats;
 }
 
-void WorkThread::run()
+void WorkerPool::addWorker (WorkerBase* worker)
 {
-    HeapBlock<uint8> buffer;
-    int32 readBufferSize = 0;
+    const ScopedLock sl (registrationLock);
+    worker->workId = 0;
 
-    while (true)
+    if (freeSlots.isEmpty())
     {
-        this->wait (-1);
-        
-        if (doExit || threadShouldExit()) 
-            break;
+        // more workers than JLV2_WORKER_POOL_MAX_WORKERS
+        jassertfalse;
+        return;
+    }
 
-        while (! validateMessage (*requests))
-            Thread::sleep (6);
+    const int index = freeSlots.removeAndReturn (freeSlots.size() - 1);
+    auto& slot = slots[index];
 
-        if (doExit || threadShouldExit()) 
-            break;
+    // generation zero would make slot zero's id zero, which means none
+    if (++slot.generation > (0xffffffffu >> slotBits))
+        slot.generation = 1;
 
-        uint32 size = 0;
-        if (requests->read (&size, sizeof (size)) < sizeof (size))
-        {
-            WORKER_LOG ("error reading request: message size");
-            continue;
-        }
+    worker->workId = (slot.generation << slotBits) | (uint32) index;
+    slot.worker.store (worker);
+    slot.id.store (worker->workId);
+    WORKER_LOG ("registering worker: " + String (worker->workId));
+}
 
-        uint32 workId;
-        if (requests->read (&workId, sizeof (workId)) < sizeof (workId))
-        {
-            WORKER_LOG ("error reading request: worker id");
-            continue;
-        }
+void WorkerPool::removeWorker (WorkerBase* worker)
+{
+    if (worker->workId == 0)
+        return;
+
+    WORKER_LOG ("removing worker: " + String (worker->workId));
+    const ScopedLock sl (registrationLock);
+    const int index = getSlotIndex (worker->workId);
+    auto& slot = slots[index];
+
+    // once the id is gone no thread can start on the worker, then wait out
+    // any which already has
+    slot.id.store (0);
+    while (slot.busy.load() != 0)
+        Thread::sleep (1);
+
+    slot.worker.store (nullptr);
+    freeSlots.add (index);
+    worker->workId = 0;
+}
 
-        if (workId == 0)
-            continue;
+WorkerBase* WorkerPool::acquire (uint32 workId)
+{
+    auto& slot = slots[getSlotIndex (workId)];
+    if (slot.id.load() != workId)
+        return nullptr;
 
-        if (size > static_cast<uint32> (readBufferSize))
-        {
-			readBufferSize = nextPowerOfTwo (size);
-            buffer.realloc (readBufferSize);
-        }
+    // only a thread which checked just before the worker was removed can
+    // hold it, and only briefly
+    int expected = 0;
+    while (! slot.busy.compare_exchange_weak (expected, 1))
+        expected = 0;
 
-        if (requests->read (buffer.getData(), size) < size)
-        {
-            WORKER_LOG ("error reading request: message body");
-            continue;
-        }
+    if (slot.id.load() == workId)
+        return slot.worker.load();
+
+    slot.busy.store (0);
+    return nullptr;
+}
 
+void WorkerPool::release (uint32 workId)
+{
+    slots[getSlotIndex (workId)].busy.store (0);
+}
+
+bool WorkerPool::enqueue (uint32 workId)
+{
+    // a worker is queued at most once, so this only fails with more
+    // workers than a queue holds
+    const int home   = getSlotIndex (workId) % numActive.load (std::memory_order_relaxed);
+    const int count  = numQueues.load (std::memory_order_relaxed);
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (queues.getUnchecked ((home + i) % count)->push (workId))
         {
-            if (WorkerBase* const worker = getWorker (workId))
-            {
-                while (! worker->flag.setWorking (true)) {}
-                worker->processRequest (size, buffer.getData());
-                while (! worker->flag.setWorking (false)) {}
-            }
+            pending.post();
+            return true;
         }
-
-        if (threadShouldExit() || doExit)
-            break;
     }
 
-    buffer.free();
+    jassertfalse;
+    return false;
 }
 
-
-bool WorkThread::scheduleWork (WorkerBase* worker, uint32 size, const void* data)
+bool WorkerPool::dequeue (int thread, uint32& workId)
 {
-    jassert (size > 0 && worker && worker->workId != 0);
-    if (! requests->canWrite (getRequiredSpace (size)))
-        return false;
+    const int count = numQueues.load (std::memory_order_relaxed);
+    for (int i = 0; i < count; ++i)
+        if (queues.getUnchecked ((thread + i) % count)->pop (workId))
+            return true;
+    return false;
+}
 
-    if (requests->write (&size, sizeof(size)) < sizeof (uint32))
-        return false;
+void WorkerPool::run (WorkThread& thread, int index)
+{
+    uint32 workId = 0;
 
-    if (requests->write (&worker->workId, sizeof (worker->workId)) < sizeof (worker->workId))
-        return false;
+    while (! thread.threadShouldExit())
+    {
+        pending.wait();
 
-    if (requests->write (data, size) < size)
-        return false;
+        while (! thread.threadShouldExit() && dequeue (index, workId))
+            runWorker (workId);
+    }
+}
 
-    notify();
-    return true;
+void WorkerPool::runWorker (uint32 workId)
+{
+    // once acquired, the worker can't be removed until it's released
+    WorkerBase* const worker = acquire (workId);
+    if (worker == nullptr)
+        return;
+
+    while (! worker->flag.setWorking (true)) {}
+
+    // records are published whole, so everything readable is complete
+    worker->readMessages (*worker->requests, [worker] (uint32 size, const void* data) {
+        worker->processRequest (size, data);
+    });
+
+    // a request written after the read above found the worker still
+    // scheduled and didn't queue it, so check again
+    worker->scheduled.store (false);
+    if (worker->requests->getReadSpace() > 0 && ! worker->scheduled.exchange (true)
+            && ! enqueue (workId))
+        worker->scheduled.store (false);
+
+    while (! worker->flag.setWorking (false)) {}
+    release (workId);
 }
 
-bool WorkThread::validateMessage (RingBuffer& ring)
+bool WorkerPool::scheduleWork (WorkerBase* worker, uint32 size, const void* data)
 {
-    uint32 size = 0;
-    ring.peak (&size, sizeof (size));
-    return ring.canRead (getRequiredSpace (size));
+    jassert (size > 0 && worker != nullptr);
+    if (worker->workId == 0 || ! worker->writeMessage (*worker->requests, size, data))
+        return false;
+
+    if (! worker->scheduled.exchange (true) && ! enqueue (worker->workId))
+        worker->scheduled.store (false);   // the next request tries again
+
+    return true;
 }
 
-WorkerBase::WorkerBase (WorkThread& thread, uint32 bufsize)
-    : owner (thread)
+WorkerBase::WorkerBase (WorkerPool& pool, uint32 bufsize)
+    : owner (pool)
 {
+    requests  = new RingBuffer (bufsize);
     responses = new RingBuffer (bufsize);
-    response.calloc (bufsize);
-    thread.addWorker (this);
+    pool.addWorker (this);
 }
 
 WorkerBase::~WorkerBase()
 {
-    while (flag.isWorking()) {
-        Thread::sleep (100);
-    }
-
+    // waits for any thread running it
     owner.removeWorker (this);
+    discardMessages();
+
+    requests  = nullptr;
     responses = nullptr;
-    response.free();
 }
 
 bool WorkerBase::scheduleWork (uint32 size, const void* data)
@@ -188,48 +303,59 @@ bool WorkerBase::scheduleWork (uint32 size, const void* data)
 
 bool WorkerBase::respondToWork (uint32 size, const void* data)
 {
-    if (! responses->canWrite (sizeof (size) + size))
-        return false;
-
-    if (responses->write (&size, sizeof (size)) < sizeof (size))
-        return false;
+    return writeMessage (*responses, size, data);
+}
 
-    if (responses->write (data, size) < size)
-        return false;
+void WorkerBase::processWorkResponses()
+{
+    readMessages (*responses, [this] (uint32 size, const void* data) {
+        processResponse (size, data);
+    });
+}
 
-    return true;
+void WorkerBase::discardMessages()
+{
+    // gives back the blocks of anything undelivered
+    auto ignore = [] (uint32, const void*) {};
+    if (requests != nullptr)
+        readMessages (*requests, ignore);
+    if (responses != nullptr)
+        readMessages (*responses, ignore);
 }
 
-void WorkerBase::processWorkResponses()
+bool WorkerBase::writeMessage (RingBuffer& ring, uint32 size, const void* data)
 {
-    uint32 remaining = responses->getReadSpace();
-    uint32 size      = 0;
+    MessageHeader header;
+    header.size = size;
 
-    while (remaining >= sizeof (uint32))
+    // anything taking more than a quarter of the ring goes in a block, so
+    // one big message can't crowd out the small ones
+    if (WorkerPool::getRequiredSpace (size) <= ring.size() / 4)
     {
-        /* respond next cycle if response isn't ready */
-        if (! validateMessage (*responses))
-            return;
-
-        responses->read (&size, sizeof (size));
-        responses->read (response.getData(), size);
-        processResponse (size, response.getData());
-        remaining -= (sizeof (uint32) + size);
+        header.block = inlineBody;
+        return ring.writeRecord (&header, sizeof (header), data, size);
     }
-}
 
-bool WorkerBase::validateMessage (RingBuffer& ring)
-{
-    // the worker only validates message size
-    uint32 size = 0;
-    ring.peak (&size, sizeof(size));
-    return ring.canRead (size + sizeof(size));
+    auto& blocks = owner.blocks;
+    const int block = blocks.allocate (size);
+    if (block < 0)
+        return false;
+
+    memcpy (blocks.getData (block), data, size);
+    header.block = (uint32) block;
+    if (ring.writeRecord (&header, sizeof (header)))
+        return true;
+
+    blocks.free (block);
+    return false;
 }
 
-void WorkerBase::setSize (uint32 newSize)
+void WorkerBase::setSize (uint32 requestSize, uint32 responseSize)
 {
-    responses = new RingBuffer (newSize);
-    response.realloc (newSize);
+    jassert (! scheduled.load());
+    discardMessages();
+    requests  = new RingBuffer ((int32) requestSize);
+    responses = new RingBuffer ((int32) responseSize);
 }
 
 }
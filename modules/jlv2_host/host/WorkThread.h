@@ -22,16 +22,50 @@ namespace jlv2 {
 
 class WorkerBase;
 
-/** A worker thread
+/** A pool of worker threads
     Capable of scheduling non-realtime work from a realtime context.
+
+    Requests queue in each worker's own ring. A worker with requests waiting
+    is put on the ready queue of one thread, picked by its id, and the pool's
+    semaphore is posted. Threads run workers from their own queue first and
+    steal from the others when it's empty, so one slow worker never holds up
+    the rest. A worker is only ever on one queue or thread at a time, which
+    keeps its requests in the order they were scheduled.
+
+    Messages too big for a worker's rings are copied into a block from a
+    preallocated pool shared by every worker, and only the block's index
+    goes through the ring.
+
+    Worker ids index a fixed table of slots directly, tagged with the slot's
+    generation so an id queued for a removed worker never finds its
+    successor. Threads look workers up without locking; only registering
+    and removing them does.
  */
-class WorkThread :  public Thread
+class WorkerPool final
 {
 public:
-    WorkThread (const String& name, uint32 bufsize, int32 priority = 5);
-    ~WorkThread();
+    WorkerPool (int numThreads, int32 priority = 5);
+    ~WorkerPool();
+
+    /** Change the number of threads. Work queued for a thread which stops
+        is taken by the others
+        @note This is NOT realtime safe */
+    void setNumThreads (int numThreads);
+
+    /** Returns the number of threads */
+    inline int getNumThreads() const { return threads.size(); }
+
+    inline static uint32 getRequiredSpace (uint32 msgSize) { return RingBuffer::getRecordSpace (msgSize + (2 * sizeof (uint32))); }
 
-    inline static uint32 getRequiredSpace (uint32 msgSize) { return msgSize + (2 * sizeof (uint32)); }
+    /** Set up the blocks which carry messages too big for a worker's rings
+        @note This is NOT realtime safe. Only call it while no workers exist */
+    void setBlocks (uint32 blockSize, int numBlocks);
+
+    /** Returns the most a large message may hold */
+    inline uint32 getBlockSize() const { return blocks.getBlockSize(); }
+
+    /** Returns the traffic through every worker's request queue */
+    QueueStats getStats() const;
 
 protected:
     friend class WorkerBase;
@@ -47,21 +81,44 @@ protected:
     bool scheduleWork (WorkerBase* worker, uint32 size, const void* data);
 
 private:
-    uint32 bufferSize;
-
-    WorkerBase* getWorker (uint32 workerId) const;
-    Array<WorkerBase*, CriticalSection> workers;
-
-    uint32 nextWorkId;
-    bool doExit = false;
-
-    ScopedPointer<RingBuffer> requests;  ///< requests to process
-
-    /** @internal Validate a ringbuffer for message completeness */
-    bool validateMessage (RingBuffer& ring);
+    class WorkThread;
+    const int32 priority;
+    OwnedArray<WorkThread> threads;
+
+    OwnedArray<MPMCQueue<uint32>> queues;   ///< ids of ready workers, one queue per possible thread
+    std::atomic<int> numActive { 1 };       ///< threads taking new work
+    std::atomic<int> numQueues { 1 };       ///< queues which may hold work
+    Semaphore pending;                      ///< posted when a worker is queued
+    BlockPool blocks;                       ///< for messages too big for a worker's rings
+
+    /** Where a registered worker lives. Its id is the slot index in the
+        low bits and the slot's generation above them */
+    enum : uint32 { slotBits = 16, slotMask = (1u << slotBits) - 1 };
+
+    struct Slot
+    {
+        std::atomic<uint32> id { 0 };           ///< id of the live worker, or 0
+        std::atomic<WorkerBase*> worker { nullptr };
+        std::atomic<int> busy { 0 };            ///< a thread is checking or running the worker
+        uint32 generation = 0;                  ///< bumped each time the slot is reused
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    Array<int> freeSlots;
+    CriticalSection registrationLock;       ///< for adding and removing workers only
+
+    static inline int getSlotIndex (uint32 workId) { return (int) (workId & slotMask); }
+    WorkerBase* acquire (uint32 workId);
+    void release (uint32 workId);
+
+    bool enqueue (uint32 workId);
+    bool dequeue (int thread, uint32& workId);
+    void runWorker (uint32 workId);
 
     /** @internal The work thread function */
-    void run();
+    void run (WorkThread& thread, int index);
+
+    JUCE_DECLARE_NON_COPYABLE (WorkerPool)
 };
 
 /** A flag that indicates whether work is happening or not */
@@ -74,16 +131,16 @@ public:
 private:
     Atomic<int32> flag;
     inline bool setWorking (bool status) { return flag.compareAndSetBool (status ? 1 : 0, status ? 0 : 1); }
-    friend class WorkThread;
+    friend class WorkerPool;
 };
 
 class WorkerBase
 {
 public:
     /** Create a new Worker
-        @param thread The WorkThread to use when scheduling
-        @param bufsize Size to use for internal response buffers */
-    WorkerBase (WorkThread& thread, uint32 bufsize);
+        @param pool The WorkerPool to use when scheduling
+        @param bufsize Size to use for internal request and response buffers */
+    WorkerBase (WorkerPool& pool, uint32 bufsize);
     virtual ~WorkerBase();
 
     /** Returns true if the worker is currently working */
@@ -104,8 +161,16 @@ public:
         response, Worker::processResponse will be called */
     void processWorkResponses();
 
-    /** Set the internal buffer size for responses */
-    void setSize (uint32 newSize);
+    /** Set the internal buffer sizes for requests and responses. Messages
+        over a quarter of their buffer go through the pool's blocks instead
+        @note Only call this while no work is scheduled */
+    void setSize (uint32 requestSize, uint32 responseSize);
+
+    /** Returns the traffic through the request queue */
+    inline QueueStats getRequestStats() const { return requests->getStats(); }
+
+    /** Returns the traffic through the response queue */
+    inline QueueStats getResponseStats() const { return responses->getStats(); }
 
 protected:
     /** Process work (worker thread) */
@@ -115,16 +180,47 @@ protected:
     virtual void processResponse (uint32 size, const void* data) = 0;
 
 private:
-    WorkThread& owner;
-    uint32 workId;                       ///< The thread assigned id for this worker
+    WorkerPool& owner;
+    uint32 workId;                       ///< The pool assigned id for this worker
     WorkFlag flag;                       ///< A flag for when work is being processed
+    std::atomic<bool> scheduled { false }; ///< on a ready queue or being run
 
+    ScopedPointer<RingBuffer> requests;  ///< requests to process, in order
     ScopedPointer<RingBuffer> responses; ///< responses from work
-    HeapBlock<uint8>          response;  ///< buffer to write a response
-
-    bool validateMessage (RingBuffer& ring);
 
-    friend class WorkThread;
+    /** Leads each message in the rings */
+    struct MessageHeader
+    {
+        uint32 block;       ///< pool block holding the body, or inlineBody
+        uint32 size;
+    };
+
+    enum : uint32 { inlineBody = 0xffffffff };
+
+    bool writeMessage (RingBuffer& ring, uint32 size, const void* data);
+    void discardMessages();
+
+    /** Call back with each message in a ring, then free its block if it had one */
+    template<typename Callback>
+    inline int readMessages (RingBuffer& ring, Callback&& callback)
+    {
+        auto& blocks = owner.blocks;
+        return ring.readRecords ([&blocks, &callback] (const uint8* data, uint32) {
+            MessageHeader header;
+            memcpy (&header, data, sizeof (header));
+            if (header.block == inlineBody)
+            {
+                callback (header.size, static_cast<const void*> (data + sizeof (header)));
+            }
+            else
+            {
+                callback (header.size, static_cast<const void*> (blocks.getData ((int) header.block)));
+                blocks.free ((int) header.block);
+            }
+        });
+    }
+
+    friend class WorkerPool;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WorkerBase);
 };
 
@@ -37,10 +37,10 @@ namespace LV2Callbacks
     }
 }
 
-WorkerFeature::WorkerFeature (WorkThread& thread, uint32 bufsize,
+WorkerFeature::WorkerFeature (WorkerPool& pool, uint32 bufsize,
                       LV2_Handle handle,
                       LV2_Worker_Interface* iface)
-    : WorkerBase (thread, bufsize)
+    : WorkerBase (pool, bufsize)
 {
     setInterface (handle, iface);
 
@@ -24,7 +24,7 @@ class WorkerFeature final : public LV2Feature,
                             public WorkerBase
 {
 public:
-    WorkerFeature (WorkThread& thread, uint32 bufsize,
+    WorkerFeature (WorkerPool& pool, uint32 bufsize,
                    LV2_Handle handle = nullptr,
                    LV2_Worker_Interface* iface = nullptr);
 
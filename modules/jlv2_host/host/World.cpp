@@ -22,48 +22,6 @@
 
 namespace jlv2 {
 
-//=============================================================================
-class OptionsFeature :  public LV2Feature
-{
-public:
-    OptionsFeature (SymbolMap& symbolMap)
-    {
-        uri = LV2_OPTIONS__options;
-        feat.URI    = uri.toRawUTF8();
-        feat.data   = options;
-
-        minBlockLengthOption = LV2_Options_Option{LV2_OPTIONS_INSTANCE,
-                                0,
-                                symbolMap.map(LV2_BUF_SIZE__minBlockLength),
-                                sizeof(int),
-                                symbolMap.map(LV2_ATOM__Int),
-                                &minBlockLengthValue};
-        maxBlockLengthOption = LV2_Options_Option{LV2_OPTIONS_INSTANCE,
-                                0,
-                                symbolMap.map(LV2_BUF_SIZE__maxBlockLength),
-                                sizeof(int),
-                                symbolMap.map(LV2_ATOM__Int),
-                                &maxBlockLengthValue};
-        options[0] = minBlockLengthOption;
-        options[1] = maxBlockLengthOption;
-        options[2] = LV2_Options_Option{LV2_OPTIONS_BLANK, 0, 0, 0, 0};                        
-    }
-
-    virtual ~OptionsFeature() { }
-
-    LV2_Options_Option minBlockLengthOption, maxBlockLengthOption;
-    LV2_Options_Option options[3];
-    const int minBlockLengthValue = 128;
-    const int maxBlockLengthValue = 8192;
-    const String& getURI() const { return uri; }
-    const LV2_Feature* getFeature() const { return &feat; }
-
-private:
-    String       uri;
-    LV2_Feature  feat;
-    friend class SymbolMap;
-};
-
 //=============================================================================
 class BoundedBlockLengthFeature : public LV2Feature
 {
@@ -108,7 +66,10 @@ World::World()
     lv2_EventPort   = lilv_new_uri (world, LV2_EVENT__EventPort);
     lv2_CVPort      = lilv_new_uri (world, LV2_CORE__CVPort);
     lv2_enumeration = lilv_new_uri (world, LV2_CORE__enumeration);
+    lv2_inPlaceBroken = lilv_new_uri (world, LV2_CORE__inPlaceBroken);
+    rsz_minimumSize = lilv_new_uri (world, LV2_RESIZE_PORT__minimumSize);
     midi_MidiEvent  = lilv_new_uri (world, LV2_MIDI__MidiEvent);
+    time_Position   = lilv_new_uri (world, LV2_TIME__Position);
     work_schedule   = lilv_new_uri (world, LV2_WORKER__schedule);
     work_interface  = lilv_new_uri (world, LV2_WORKER__interface);
     options_options = lilv_new_uri (world, LV2_OPTIONS__options);
@@ -136,18 +97,15 @@ World::World()
                           ModuleUI::portUnsubscribe);
     suil_host_set_touch_func (suil, ModuleUI::touch);
 
-    currentThread = 0;
-    numThreads    = JLV2_NUM_WORKERS;
-    for (int i = 0; i < numThreads; ++i)
-    {
-        threads.add (new WorkThread ("lv2_worker_" + String(i + 1), 2048));
-        threads.getLast()->setPriority (5);
-    }
+    workerPool.reset (new WorkerPool (JLV2_NUM_WORKERS, 5));
+    workerPool->setBlocks (bufferPolicy.workerBlockSize, bufferPolicy.numWorkerBlocks);
 
     addFeature (symbolMap.createMapFeature(), false);
     addFeature (symbolMap.createUnmapFeature(), false);
     addFeature (new LogFeature(), true);
-    addFeature (new OptionsFeature(symbolMap), true);
+    addFeature (new OptionsFeature (symbolMap.map (LV2_BUF_SIZE__minBlockLength),
+                                    symbolMap.map (LV2_BUF_SIZE__maxBlockLength),
+                                    symbolMap.map (LV2_ATOM__Int)), true);
     addFeature (new BoundedBlockLengthFeature(), true);
 }
 
@@ -162,7 +120,10 @@ World::~World()
     _node_free (lv2_EventPort);
     _node_free (lv2_CVPort);
     _node_free (lv2_enumeration);
+    _node_free (lv2_inPlaceBroken);
+    _node_free (rsz_minimumSize);
     _node_free (midi_MidiEvent);
+    _node_free (time_Position);
     _node_free (work_schedule);
     _node_free (work_interface);
     _node_free (options_options);
@@ -257,18 +218,56 @@ const LilvPlugins* World::getAllPlugins() const
     return lilv_world_get_all_plugins (world);
 }
 
-WorkThread& World::getWorkThread()
+void World::setNumWorkThreads (int numThreads)
+{
+    workerPool->setNumThreads (numThreads);
+}
+
+int32 World::getNumWorkThreads() const
+{
+    return workerPool->getNumThreads();
+}
+
+void World::setBufferPolicy (const BufferPolicy& policy)
+{
+    const ScopedLock sl (modules.getLock());
+
+    // running modules may hold worker blocks, so those are fixed once any exist
+    jassert (modules.isEmpty() || (policy.workerBlockSize == bufferPolicy.workerBlockSize
+                                   && policy.numWorkerBlocks == bufferPolicy.numWorkerBlocks));
+    const auto oldPolicy = bufferPolicy;
+    bufferPolicy = policy;
+
+    if (modules.isEmpty())
+    {
+        workerPool->setBlocks (policy.workerBlockSize, policy.numWorkerBlocks);
+    }
+    else
+    {
+        bufferPolicy.workerBlockSize = oldPolicy.workerBlockSize;
+        bufferPolicy.numWorkerBlocks = oldPolicy.numWorkerBlocks;
+    }
+}
+
+World::QueueReport World::getQueueReport() const
 {
-    while (threads.size() < numThreads) {
-        threads.add (new WorkThread ("LV2 Worker " + String(threads.size()), 2048));
-        threads.getLast()->setPriority (5);
+    QueueReport report;
+
+    {
+        const ScopedLock sl (modules.getLock());
+        for (auto* const module : modules)
+        {
+            report.events        += module->getEventStats();
+            report.notifications += module->getNotificationStats();
+            report.workResponses += module->getWorkResponseStats();
+        }
+
+        report.numModules = modules.size();
     }
 
-    const int32 threadIndex = currentThread;
-    if (++currentThread >= numThreads)
-        currentThread = 0;
+    report.workRequests = workerPool->getStats();
 
-    return *threads.getUnchecked (threadIndex);
+    return report;
 }
 
 bool World::isFeatureSupported (const String& featureURI) const
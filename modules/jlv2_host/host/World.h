@@ -36,7 +36,7 @@ namespace jlv2 {
 /** Slim wrapper around LilvWorld.  Publishes commonly used LilvNodes and
     manages heavy weight features (like LV2 Worker)
  */
-class World
+class JLV2_API World
 {
 public:
     World();
@@ -50,10 +50,13 @@ public:
     const LilvNode*   lv2_EventPort;
     const LilvNode*   lv2_CVPort;
     const LilvNode*   lv2_enumeration;
+    const LilvNode*   lv2_inPlaceBroken;
     const LilvNode*   midi_MidiEvent;
+    const LilvNode*   time_Position;
     const LilvNode*   work_schedule;
     const LilvNode*   work_interface;
     const LilvNode*   options_options;
+    const LilvNode*   rsz_minimumSize;
     const LilvNode*   ui_CocoaUI;
     const LilvNode*   ui_WindowsUI;
     const LilvNode*   ui_X11UI;
@@ -105,11 +108,15 @@ public:
         to a plugin instance */
     inline void getFeatures (Array<const LV2_Feature*>& feats) const { features.getFeatures (feats); }
 
-    /** Get a worker thread */
-    inline WorkThread& getWorkThread();
+    /** Returns the pool which runs every plugin's worker */
+    inline WorkerPool& getWorkerPool() { return *workerPool; }
+
+    /** Change the number of worker threads
+        @note This is NOT realtime safe */
+    void setNumWorkThreads (int numThreads);
 
     /** Returns the total number of available worker threads */
-    inline int32 getNumWorkThreads() const { return numThreads; }
+    int32 getNumWorkThreads() const;
     
     /** Returns a plugin's name by URI, or empty if not found */
     String getPluginName (const String& uri) const;
@@ -135,15 +142,52 @@ public:
     /** Unmap a URID */
     String unmap (uint32 urid) { return symbolMap.unmap (urid); }
 
+    /** How Modules size their port buffers and queues. A port asking for
+        more with rsz:minimumSize always gets what it asks for */
+    struct BufferPolicy
+    {
+        uint32 atomBufferSize     = 4096;   ///< atom and event ports without rsz:minimumSize
+        uint32 queueSize          = 512;    ///< base size of each Module's event and notification queues, in bytes
+        uint32 workerBufferSize   = 2048;   ///< each plugin's worker request queue
+        uint32 workerResponseSize = 2048;   ///< each plugin's worker response queue
+        uint32 workerBlockSize    = 65536;  ///< largest worker message, for those too big for the queues
+        int numWorkerBlocks       = 32;     ///< large worker messages in flight at once, over all plugins
+    };
+
+    /** Change how Modules created from now on size their buffers. The
+        worker block settings can only change before any Module exists */
+    void setBufferPolicy (const BufferPolicy& policy);
+
+    /** Returns how Modules size their buffers */
+    inline const BufferPolicy& getBufferPolicy() const { return bufferPolicy; }
+
+    /** Queue traffic summed over every live Module and work thread */
+    struct QueueReport
+    {
+        QueueStats events;          ///< port events into Module::run()
+        QueueStats notifications;   ///< atom output events out of Module::run()
+        QueueStats workRequests;    ///< requests to the worker pool
+        QueueStats workResponses;   ///< responses from workers
+        int numModules = 0;
+    };
+
+    /** Returns the queue traffic of every live Module and work thread
+        @note Call this from the message thread only */
+    QueueReport getQueueReport() const;
+
 private:
+    friend class Module;
     LilvWorld* world = nullptr;
     SuilHost* suil = nullptr;
     SymbolMap symbolMap;
     LV2FeatureArray features;
+    BufferPolicy bufferPolicy;
+
+    std::unique_ptr<WorkerPool> workerPool;
 
-    // a simple rotating thread pool
-    int32 currentThread, numThreads;
-    OwnedArray<WorkThread> threads;
+    Array<Module*, CriticalSection> modules;
+    void addModule (Module* module)     { modules.add (module); }
+    void removeModule (Module* module)  { modules.removeFirstMatchingValue (module); }
 };
 
 }
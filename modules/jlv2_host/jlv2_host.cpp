@@ -28,50 +28,43 @@
 #include "jlv2_host/jlv2_host.h"
 
 #if JLV2_PLUGINHOST_LV2
+#include <juce_audio_formats/juce_audio_formats.h>
 #include <juce_gui_extra/juce_gui_extra.h>
-#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
-#include <lv2/lv2plug.in/ns/extensions/ui/ui.h>
-#include <lv2/lv2plug.in/ns/extensions/units/units.h>
-#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
-#include <lv2/lv2plug.in/ns/ext/atom/util.h>
-#include <lv2/lv2plug.in/ns/ext/buf-size/buf-size.h>
-#include <lv2/lv2plug.in/ns/ext/data-access/data-access.h>
-#include <lv2/lv2plug.in/ns/ext/event/event.h>
-#include <lv2/lv2plug.in/ns/ext/instance-access/instance-access.h>
-#include <lv2/lv2plug.in/ns/ext/log/log.h>
-#include <lv2/lv2plug.in/ns/ext/midi/midi.h>
-#include <lv2/lv2plug.in/ns/ext/options/options.h>
-#include <lv2/lv2plug.in/ns/ext/state/state.h>
-#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
-#include <lv2/lv2plug.in/ns/ext/uri-map/uri-map.h>
-#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
 
-#include <lilv/lilv.h>
-#include <suil/suil.h>
-
-namespace jlv2 {
- class Module;
- class ModuleUI;
-}
-
-#include <unordered_map>
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <semaphore.h>
+#endif
 
-#include "host/PortType.h"
-#include "host/PortBuffer.h"
-#include "host/PortEvent.h"
-#include "host/LV2Features.h"
-#include "host/SymbolMap.h"
-#include "host/RingBuffer.h"
+#include "host/AtomWriter.h"
+#include "host/OptionsFeature.h"
+#include "host/PortEventQueue.h"
+#include "host/ControlSlots.h"
+#include "host/TripleBuffer.h"
+#include "host/WorkStealingDeque.h"
+#include "host/MPMCQueue.h"
+#include "host/BlockPool.h"
+#include "host/Semaphore.h"
 #include "host/WorkThread.h"
 #include "host/LogFeature.h"
 #include "host/WorkerFeature.h"
-#include "host/World.h"
-#include "host/Module.h"
 
+#include "host/AtomWriter.cpp"
+#include "host/BufferPlanner.cpp"
 #include "host/LogFeature.cpp"
 #include "host/LV2PluginFormat.cpp"
 #include "host/Module.cpp"
+#include "host/ModuleChain.cpp"
+#include "host/ModuleGraph.cpp"
+#include "host/ModulePool.cpp"
 #include "host/PortBuffer.cpp"
+#include "host/RenderSession.cpp"
 #include "host/RingBuffer.cpp"
 #include "host/WorkerFeature.cpp"
 #include "host/WorkThread.cpp"
@@ -25,7 +25,7 @@
     website:          https://lvtoolkit.org
     license:          GPL
 
-    dependencies:     juce_core
+    dependencies:     juce_core, juce_audio_formats
     OSXFrameworks:
     iOSFrameworks:
     linuxLibs:
@@ -68,11 +68,57 @@
 #endif
 
 
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
+#include <lv2/lv2plug.in/ns/extensions/ui/ui.h>
+#include <lv2/lv2plug.in/ns/extensions/units/units.h>
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+#include <lv2/lv2plug.in/ns/ext/buf-size/buf-size.h>
+#include <lv2/lv2plug.in/ns/ext/data-access/data-access.h>
+#include <lv2/lv2plug.in/ns/ext/event/event.h>
+#include <lv2/lv2plug.in/ns/ext/instance-access/instance-access.h>
+#include <lv2/lv2plug.in/ns/ext/log/log.h>
+#include <lv2/lv2plug.in/ns/ext/midi/midi.h>
+#include <lv2/lv2plug.in/ns/ext/options/options.h>
+#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+#include <lv2/lv2plug.in/ns/ext/resize-port/resize-port.h>
+#include <lv2/lv2plug.in/ns/ext/state/state.h>
+#include <lv2/lv2plug.in/ns/ext/time/time.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/ext/uri-map/uri-map.h>
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
+
+#include <lilv/lilv.h>
+#include <suil/suil.h>
+
+#include <unordered_map>
+
 namespace jlv2 {
 using namespace juce;
+class Module;
+class ModuleUI;
 class World;
 class SymbolMap;
+class OptionsFeature;
+class PortEventQueue;
+class WorkerFeature;
+class WorkerPool;
+template<typename ElementType> class WorkStealingDeque;
 }
 
+#include "host/PortType.h"
+#include "host/PortBuffer.h"
+#include "host/PortEvent.h"
+#include "host/LV2Features.h"
+#include "host/SymbolMap.h"
+#include "host/RingBuffer.h"
+#include "host/BufferPlanner.h"
+#include "host/World.h"
+#include "host/Module.h"
+#include "host/ModuleChain.h"
+#include "host/ModuleGraph.h"
+#include "host/ModulePool.h"
 #include "host/LV2PluginFormat.h"
+#include "host/RenderSession.h"
 #endif
@@ -0,0 +1,87 @@
+
+#include <juce/juce.h>
+#include <jlv2/jlv2.h>
+#include <iostream>
+
+using namespace juce;
+
+static int usage()
+{
+    std::cerr << "usage: lv2render [options] <plugin-uri> <input> <output> [<input> <output> ...]" << std::endl
+              << std::endl
+              << "  -m <file>     standard MIDI file to play" << std::endl
+              << "  -a <file>     automation file ('seconds symbol value' per line)" << std::endl
+              << "  -r <rate>     sample rate (default: input rate, or 48000)" << std::endl
+              << "  -b <frames>   block size (default: 4096)" << std::endl
+              << "  -d <bits>     output bit depth (default: 24)" << std::endl
+              << "  -t <seconds>  tail to render after the input ends" << std::endl
+              << "  -j <threads>  number of files to render at once" << std::endl
+              << std::endl
+              << "Use '-' as the input to render without an input file." << std::endl;
+    return 1;
+}
+
+int main (int argc, char** argv)
+{
+    ScopedJuceInitialiser_GUI initialiser;
+    StringArray args (argv + 1, argc - 1);
+
+    jlv2::RenderSession session;
+    jlv2::RenderSession::Job proto;
+    int numThreads = SystemStats::getNumCpus();
+
+    while (args.size() > 0 && args[0].startsWithChar ('-') && args[0].length() == 2)
+    {
+        if (args.size() < 2)
+            return usage();
+
+        const auto opt = args[0][1];
+        const auto value = args[1];
+        args.removeRange (0, 2);
+
+        switch (opt)
+        {
+            case 'm': proto.midi = File::getCurrentWorkingDirectory().getChildFile (value); break;
+            case 'a': proto.automation = File::getCurrentWorkingDirectory().getChildFile (value); break;
+            case 'r': session.setSampleRate (value.getDoubleValue()); break;
+            case 'b': session.setBlockSize (value.getIntValue()); break;
+            case 'd': session.setBitDepth (value.getIntValue()); break;
+            case 't': proto.tailSeconds = value.getDoubleValue(); break;
+            case 'j': numThreads = jmax (1, value.getIntValue()); break;
+            default:  return usage();
+        }
+    }
+
+    if (args.size() < 3 || (args.size() - 1) % 2 != 0)
+        return usage();
+
+    proto.pluginURI = args[0];
+    Array<jlv2::RenderSession::Job> jobs;
+    for (int i = 1; i < args.size(); i += 2)
+    {
+        auto job = proto;
+        if (args[i] != "-")
+            job.input = File::getCurrentWorkingDirectory().getChildFile (args[i]);
+        job.output = File::getCurrentWorkingDirectory().getChildFile (args[i + 1]);
+        jobs.add (job);
+    }
+
+    Array<Result> results;
+    const auto start = Time::getMillisecondCounterHiRes();
+    session.render (jobs, numThreads, &results);
+    const auto elapsed = (Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    int failures = 0;
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        const auto& result = results.getReference (i);
+        std::cout << jobs.getReference(i).output.getFullPathName() << ": "
+                  << (result.wasOk() ? String ("ok") : result.getErrorMessage()) << std::endl;
+        if (result.failed())
+            ++failures;
+    }
+
+    std::cout << "rendered " << jobs.size() - failures << "/" << jobs.size()
+              << " files in " << String (elapsed, 2) << "s" << std::endl;
+    return failures > 0 ? 1 : 0;
+}